@@ -1,345 +1,4598 @@
 #include "skiplist.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <omp.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
-#define MAX_LEVEL 10        // the default skiplist has 10 levels
+#define MAX_LEVEL 32        // tallest tower a list can be configured with
 #define MAX_INT 2147483647  // infinity as int
+#define CACHE_LINE 64
+#define MAX_THREADS 64      // threads past this share one slot of per-list state under a lock; at most 64
 
-// Initialize a sequential/coarse-grained lock node
-Node* node_init(int val) {
-    Node* newNode = (Node*)malloc(sizeof(Node));
+// ======================================================================== //
+// ======================== T H R E A D   S L O T S ======================= //
+// ======================================================================== //
+
+// Per-thread state is indexed by the calling thread's slot, not by its OpenMP thread number,
+// which threads of nested or concurrent teams and plain pthreads share. A thread takes the
+// lowest free slot on its first call and gives it back when it exits. A thread finding all
+// MAX_THREADS taken keeps MAX_THREADS, whose state is shared under a lock or atomically:
+// a slot never changes between an enter and an exit or a lock and an unlock.
+static _Atomic uint64_t slots_taken;
+static pthread_key_t slot_key;
+static pthread_once_t slot_once = PTHREAD_ONCE_INIT;
+static _Thread_local int thread_slot_id = -1;
+
+static void slot_release(void* slot) {
+    atomic_fetch_and(&slots_taken, ~(1ULL << ((intptr_t)slot - 1)));
+}
+
+static void slot_key_init(void) {
+    pthread_key_create(&slot_key, slot_release);
+}
+
+static int slot_take(void) {
+    uint64_t taken = atomic_load(&slots_taken);
+    int slot;
+    do {
+        if (taken == ~0ULL)
+            return thread_slot_id = MAX_THREADS;
+        slot = __builtin_ctzll(~taken);
+    } while (!atomic_compare_exchange_weak(&slots_taken, &taken, taken | (1ULL << slot)));
+    pthread_once(&slot_once, slot_key_init);
+    pthread_setspecific(slot_key, (void*)(intptr_t)(slot + 1));
+    thread_slot_id = slot;
+    return slot;
+}
+
+static inline int thread_slot(void) {
+    return thread_slot_id >= 0 ? thread_slot_id : slot_take();
+}
+
+// ======================================================================== //
+// ============================== S T A T S =============================== //
+// ======================================================================== //
+
+// With -DSKIPLIST_STATS every thread counts into its own slot of one global table, which
+// skiplist_stats adds up. Only the owning thread writes a slot, with a plain load and store;
+// threads past MAX_THREADS share the last slot and may lose counts. Without it the STAT_
+// hooks are empty and lock_acquire is omp_set_lock.
+
+#ifdef SKIPLIST_STATS
+typedef struct Stats_Slot {
+    _Alignas(CACHE_LINE) _Atomic long ops[STAT_OPS];
+    _Atomic long latency[STAT_OPS][STATS_BUCKETS];
+    _Atomic long visited[MAX_LEVEL];
+    _Atomic long lock_acquires, lock_contended, lock_wait_ns, retries, allocs;
+} Stats_Slot;
+
+static Stats_Slot stats_slots[MAX_THREADS + 1];
+
+static inline Stats_Slot* stats_slot(void) {
+    return &stats_slots[thread_slot()];
+}
+
+static inline void stats_add(_Atomic long* counter, long n) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+static inline uint64_t stats_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void stats_op(Stat_Op op, uint64_t start) {
+    uint64_t ns = stats_now() - start;
+    int bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+    Stats_Slot* slot = stats_slot();
+    stats_add(&slot->ops[op], 1);
+    stats_add(&slot->latency[op][bucket < STATS_BUCKETS ? bucket : STATS_BUCKETS - 1], 1);
+}
+
+// Take an omp lock, timing the wait if another thread holds it
+static void lock_acquire(omp_lock_t* lock) {
+    Stats_Slot* slot = stats_slot();
+    stats_add(&slot->lock_acquires, 1);
+    if (omp_test_lock(lock))
+        return;
+    uint64_t start = stats_now();
+    omp_set_lock(lock);
+    stats_add(&slot->lock_contended, 1);
+    stats_add(&slot->lock_wait_ns, stats_now() - start);
+}
+
+#define STAT_ADD(field, n)      stats_add(&stats_slot()->field, n)
+#define STAT_VISIT(level)       stats_add(&stats_slot()->visited[level], 1)
+#define STAT_TIMER(start)       uint64_t start = stats_now()
+#define STAT_OP(op, start)      stats_op(op, start)
+#else
+#define STAT_ADD(field, n)      ((void)0)
+#define STAT_VISIT(level)       ((void)0)
+#define STAT_TIMER(start)       ((void)0)
+#define STAT_OP(op, start)      ((void)0)
+#define lock_acquire(lock)      omp_set_lock(lock)
+#endif
+
+// Returns false, with stats zeroed, if the counters were compiled out
+bool skiplist_stats(Skiplist_Stats* stats) {
+    memset(stats, 0, sizeof(Skiplist_Stats));
+#ifdef SKIPLIST_STATS
+    for (int t = 0; t <= MAX_THREADS; t++) {
+        Stats_Slot* slot = &stats_slots[t];
+        for (int op = 0; op < STAT_OPS; op++) {
+            stats->ops[op] += atomic_load_explicit(&slot->ops[op], memory_order_relaxed);
+            for (int b = 0; b < STATS_BUCKETS; b++) {
+                stats->latency[op][b] += atomic_load_explicit(&slot->latency[op][b], memory_order_relaxed);
+            }
+        }
+        for (int level = 0; level < MAX_LEVEL; level++) {
+            stats->visited[level] += atomic_load_explicit(&slot->visited[level], memory_order_relaxed);
+        }
+        stats->lock_acquires += atomic_load_explicit(&slot->lock_acquires, memory_order_relaxed);
+        stats->lock_contended += atomic_load_explicit(&slot->lock_contended, memory_order_relaxed);
+        stats->lock_wait_ns += atomic_load_explicit(&slot->lock_wait_ns, memory_order_relaxed);
+        stats->retries += atomic_load_explicit(&slot->retries, memory_order_relaxed);
+        stats->allocs += atomic_load_explicit(&slot->allocs, memory_order_relaxed);
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Not synchronized with counting threads: call it while the lists are idle
+void skiplist_stats_reset() {
+#ifdef SKIPLIST_STATS
+    memset(stats_slots, 0, sizeof(stats_slots));
+#endif
+}
+
+// The latency percentile p of an operation, as the upper end of its histogram bucket
+static long stats_percentile(const Skiplist_Stats* stats, int op, double p) {
+    long seen = 0;
+    for (int b = 0; b < STATS_BUCKETS; b++) {
+        seen += stats->latency[op][b];
+        if (seen > p * stats->ops[op])
+            return 2L << b;
+    }
+    return 0;
+}
+
+void skiplist_stats_dump() {
+    static const char* names[STAT_OPS] = { "search", "insert", "delete", "scan" };
+    Skiplist_Stats stats;
+    if (!skiplist_stats(&stats)) {
+        printf("skiplist stats: compiled out, build skiplist.c with -DSKIPLIST_STATS\n");
+        return;
+    }
+    printf("Operation |        ops | p50 (ns) <= | p99 (ns) <= | p999 (ns) <=\n");
+    for (int op = 0; op < STAT_OPS; op++) {
+        printf("%-9s | %10ld | %11ld | %11ld | %12ld\n", names[op], stats.ops[op],
+               stats_percentile(&stats, op, 0.5), stats_percentile(&stats, op, 0.99), stats_percentile(&stats, op, 0.999));
+    }
+    long ops = stats.ops[STAT_SEARCH] + stats.ops[STAT_INSERT] + stats.ops[STAT_DELETE];
+    printf("Nodes visited per level, per search/insert/delete:\n");
+    for (int level = MAX_LEVEL - 1; level >= 0; level--) {
+        if (stats.visited[level])
+            printf("  level %2d: %12ld  (%.2f)\n", level + 1, stats.visited[level], ops ? (double)stats.visited[level] / ops : 0.0);
+    }
+    printf("Locks: %ld taken, %ld contended, %.3f ms waited\n", stats.lock_acquires, stats.lock_contended, stats.lock_wait_ns / 1e6);
+    printf("Retries: %ld   Node allocations: %ld\n", stats.retries, stats.allocs);
+}
+
+// ======================================================================== //
+// ===================== N O D E   A L L O C A T O R ====================== //
+// ======================================================================== //
+
+#define SLAB_SIZE (64 * 1024)   // a slab is carved into blocks of a single size class
+#define SLAB_CLASSES 7          // power of two block sizes 16, 32, ..., 1024 bytes
+
+// Per-thread state: a free list and a partly carved slab for every size class.
+// Blocks of at most 64 bytes never straddle a cache line, larger ones start on one.
+typedef struct Slab_Cache {
+    _Alignas(CACHE_LINE) void* free_list[SLAB_CLASSES];    // freed blocks, linked through their first word
+    char* bump[SLAB_CLASSES];                               // next uncarved block of the current slab
+    char* end[SLAB_CLASSES];
+    void* slabs;                                            // every slab of this cache, linked through their first word
+    long sys_allocs;                                        // calls into malloc made by this thread
+} Slab_Cache;
+
+struct Node_Allocator {
+    Slab_Cache caches[MAX_THREADS + 1];
+    Alloc_Type type;
+    int numa_node;              // ALLOC_SLAB: the NUMA node slabs are bound to, -1 to leave them to first touch
+    omp_lock_t overflow_lock;   // guards caches[MAX_THREADS]
+};
+
+static Node_Allocator* allocator_init(const Skiplist_Config* config) {
+    Node_Allocator* alloc = (Node_Allocator*)aligned_alloc(CACHE_LINE, sizeof(Node_Allocator));
+    memset(alloc, 0, sizeof(Node_Allocator));
+    alloc->type = config ? config->alloc : ALLOC_MALLOC;
+    alloc->numa_node = -1;
+    omp_init_lock(&alloc->overflow_lock);
+    return alloc;
+}
+
+// Pick the cache of the calling thread
+static Slab_Cache* cache_acquire(Node_Allocator* alloc) {
+    int slot = thread_slot();
+    if (slot < MAX_THREADS)
+        return &alloc->caches[slot];
+    omp_set_lock(&alloc->overflow_lock);
+    return &alloc->caches[MAX_THREADS];
+}
+
+static void cache_release(Node_Allocator* alloc, Slab_Cache* cache) {
+    if (cache == &alloc->caches[MAX_THREADS])
+        omp_unset_lock(&alloc->overflow_lock);
+}
+
+static int size_class(size_t size) {
+    int cls = 0;
+    while (((size_t)16 << cls) < size) {
+        cls++;
+    }
+    return cls;
+}
+
+#define NUMA_PAGE 4096          // mbind works on whole pages
+#define MPOL_PREFERRED_NODE 1   // MPOL_PREFERRED and MPOL_MF_MOVE of <numaif.h>, which needs libnuma
+#define MPOL_MOVE_PAGES 2
+
+// Ask for the pages of [addr, addr + bytes) on a NUMA node. Without NUMA support, or for a
+// node the machine does not have, the call fails and the pages stay where first touched.
+static void numa_bind(void* addr, size_t bytes, int node) {
+#ifdef SYS_mbind
+    unsigned long mask = 1UL << node;
+    if (node < (int)(8 * sizeof(mask)))
+        syscall(SYS_mbind, addr, bytes, MPOL_PREFERRED_NODE, &mask, 8 * sizeof(mask) + 1, MPOL_MOVE_PAGES);
+#else
+    (void)addr, (void)bytes, (void)node;
+#endif
+}
+
+// Get a cache line aligned slab of at least `size` bytes; its first line holds the link to the previous one.
+// Slabs bound to a NUMA node are page aligned.
+static char* slab_new(Node_Allocator* alloc, Slab_Cache* cache, size_t size) {
+    size_t align = alloc->numa_node >= 0 ? NUMA_PAGE : CACHE_LINE;
+    size_t bytes = (size + align - 1) / align * align;
+    char* slab = (char*)aligned_alloc(align, bytes);
+    if (alloc->numa_node >= 0)
+        numa_bind(slab, bytes, alloc->numa_node);
+    *(void**)slab = cache->slabs;
+    cache->slabs = slab;
+    cache->sys_allocs++;
+    return slab;
+}
+
+void* node_alloc(Node_Allocator* alloc, size_t size) {
+    STAT_ADD(allocs, 1);
+    Slab_Cache* cache = cache_acquire(alloc);
+    int cls = size_class(size);
+    void* block;
+    if (alloc->type == ALLOC_MALLOC) {
+        block = malloc(size);
+        cache->sys_allocs++;
+    } else if (cls >= SLAB_CLASSES) {
+        // Oversized blocks get a slab of their own so they are still released with the list
+        block = slab_new(alloc, cache, CACHE_LINE + size) + CACHE_LINE;
+    } else if (cache->free_list[cls]) {
+        block = cache->free_list[cls];
+        cache->free_list[cls] = *(void**)block;
+    } else {
+        size_t block_size = (size_t)16 << cls;
+        if ((size_t)(cache->end[cls] - cache->bump[cls]) < block_size) {
+            char* slab = slab_new(alloc, cache, SLAB_SIZE);
+            cache->bump[cls] = slab + CACHE_LINE;
+            cache->end[cls] = slab + SLAB_SIZE;
+        }
+        block = cache->bump[cls];
+        cache->bump[cls] += block_size;
+    }
+    cache_release(alloc, cache);
+    return block;
+}
+
+// Slab blocks go to the free list of the calling thread, whichever thread carved them
+void node_free(Node_Allocator* alloc, void* block, size_t size) {
+    if (alloc->type == ALLOC_MALLOC) {
+        free(block);
+        return;
+    }
+    int cls = size_class(size);
+    if (cls >= SLAB_CLASSES)
+        return;
+    Slab_Cache* cache = cache_acquire(alloc);
+    *(void**)block = cache->free_list[cls];
+    cache->free_list[cls] = block;
+    cache_release(alloc, cache);
+}
+
+// Release every slab at once; in malloc mode the nodes must have been freed one by one already
+static void allocator_free(Node_Allocator* alloc) {
+    for (int i = 0; i <= MAX_THREADS; i++) {
+        void* slab = alloc->caches[i].slabs;
+        while (slab) {
+            void* del = slab;
+            slab = *(void**)slab;
+            free(del);
+        }
+    }
+    omp_destroy_lock(&alloc->overflow_lock);
+    free(alloc);
+}
+
+// Number of malloc calls made on behalf of the list: one per node with ALLOC_MALLOC, one per slab with ALLOC_SLAB
+long allocator_sys_allocs(const Node_Allocator* alloc) {
+    long total = 0;
+    for (int i = 0; i <= MAX_THREADS; i++) {
+        total += alloc->caches[i].sys_allocs;
+    }
+    return total;
+}
+
+// ======================================================================== //
+// ================= E P O C H   R E C L A M A T I O N ==================== //
+// ======================================================================== //
+
+// A node unlinked by a delete may still be read by a concurrent search, so it is
+// retired instead of freed. Every operation runs inside an epoch critical section;
+// a node retired in epoch e is freed once the global epoch reaches e + 2, which
+// means every thread that could have seen it has left its critical section.
+
+#define EPOCH_BATCH 64          // retires between two attempts to advance the global epoch
+
+// Nodes retired by one thread in one epoch
+typedef struct Epoch_Bag {
+    void** nodes;
+    int count, capacity;
+    unsigned long epoch;
+} Epoch_Bag;
+
+typedef struct Epoch_Thread {
+    _Alignas(CACHE_LINE) _Atomic unsigned long state;  // (epoch << 1) | 1 inside a critical section, 0 outside
+    int depth;                                          // critical sections nest; see overflow_nest
+    unsigned long retires;
+    Epoch_Bag bags[3];                                  // indexed by epoch % 3
+} Epoch_Thread;
+
+struct Epoch_Domain {
+    _Alignas(CACHE_LINE) _Atomic unsigned long epoch;
+    Epoch_Thread threads[MAX_THREADS + 1];
+    omp_lock_t overflow_lock;   // held for the whole critical section by threads using threads[MAX_THREADS]
+    void (*reclaim)(void* list, void* node);
+    void* list;
+};
+
+static Epoch_Domain* epoch_init(void (*reclaim)(void* list, void* node), void* list) {
+    Epoch_Domain* domain = (Epoch_Domain*)aligned_alloc(CACHE_LINE, sizeof(Epoch_Domain));
+    memset(domain, 0, sizeof(Epoch_Domain));
+    atomic_init(&domain->epoch, 0);
+    omp_init_lock(&domain->overflow_lock);
+    domain->reclaim = reclaim;
+    domain->list = list;
+    return domain;
+}
+
+static void bag_reclaim(Epoch_Domain* domain, Epoch_Bag* bag) {
+    for (int i = 0; i < bag->count; i++) {
+        domain->reclaim(domain->list, bag->nodes[i]);
+    }
+    bag->count = 0;
+}
+
+static Epoch_Thread* epoch_thread(Epoch_Domain* domain) {
+    return &domain->threads[thread_slot()];
+}
+
+// How deep a thread using threads[MAX_THREADS] is in each domain it is inside: the depth
+// kept there belongs to whichever thread holds the lock, so it cannot tell others apart
+typedef struct Overflow_Depth {
+    Epoch_Domain* domain;
+    int depth;
+} Overflow_Depth;
+
+static _Thread_local Overflow_Depth* overflow_depths;
+static _Thread_local int overflow_count;
+
+// Add step to this thread's depth in domain and return the new depth
+static int overflow_nest(Epoch_Domain* domain, int step) {
+    int i = 0;
+    while (i < overflow_count && overflow_depths[i].domain != domain) {
+        i++;
+    }
+    if (i == overflow_count) {
+        overflow_depths = (Overflow_Depth*)realloc(overflow_depths, (overflow_count + 1) * sizeof(Overflow_Depth));
+        overflow_depths[overflow_count++] = (Overflow_Depth){domain, 0};
+    }
+    int depth = overflow_depths[i].depth += step;
+    if (depth == 0)
+        overflow_depths[i] = overflow_depths[--overflow_count];
+    return depth;
+}
+
+void epoch_enter(Epoch_Domain* domain) {
+    Epoch_Thread* self = epoch_thread(domain);
+    if (self == &domain->threads[MAX_THREADS] && overflow_nest(domain, 1) == 1)
+        omp_set_lock(&domain->overflow_lock);
+    if (self->depth++ > 0)
+        return;
+    // Announce the epoch, then check it did not move before the announcement became visible
+    unsigned long epoch;
+    do {
+        epoch = atomic_load(&domain->epoch);
+        atomic_store(&self->state, (epoch << 1) | 1);
+    } while (epoch != atomic_load(&domain->epoch));
+    // Free what was retired two or more epochs ago
+    for (int i = 0; i < 3; i++) {
+        if (self->bags[i].count && self->bags[i].epoch + 2 <= epoch)
+            bag_reclaim(domain, &self->bags[i]);
+    }
+}
+
+void epoch_exit(Epoch_Domain* domain) {
+    Epoch_Thread* self = epoch_thread(domain);
+    bool overflow = self == &domain->threads[MAX_THREADS];
+    if (overflow)
+        overflow_nest(domain, -1);
+    if (--self->depth > 0)
+        return;
+    atomic_store_explicit(&self->state, 0, memory_order_release);
+    if (overflow)
+        omp_unset_lock(&domain->overflow_lock);
+}
+
+// The global epoch moves on only once every thread inside a critical section has announced it
+static void epoch_try_advance(Epoch_Domain* domain) {
+    unsigned long epoch = atomic_load(&domain->epoch);
+    for (int i = 0; i <= MAX_THREADS; i++) {
+        unsigned long state = atomic_load(&domain->threads[i].state);
+        if ((state & 1) && (state >> 1) != epoch)
+            return;
+    }
+    atomic_compare_exchange_strong(&domain->epoch, &epoch, epoch + 1);
+}
+
+// Must be called inside a critical section, after the node has been unlinked
+void epoch_retire(Epoch_Domain* domain, void* node) {
+    Epoch_Thread* self = epoch_thread(domain);
+    // Tag with the global epoch, not the one this thread announced: a thread that entered
+    // since the epoch moved on may still see the node
+    unsigned long epoch = atomic_load(&domain->epoch);
+    Epoch_Bag* bag = &self->bags[epoch % 3];
+    if (bag->epoch != epoch) {
+        // The bag still holds nodes from three epochs ago, which are safe by now
+        bag_reclaim(domain, bag);
+        bag->epoch = epoch;
+    }
+    if (bag->count == bag->capacity) {
+        bag->capacity = bag->capacity ? bag->capacity * 2 : EPOCH_BATCH;
+        bag->nodes = (void**)realloc(bag->nodes, bag->capacity * sizeof(void*));
+    }
+    bag->nodes[bag->count++] = node;
+    if (++self->retires % EPOCH_BATCH == 0)
+        epoch_try_advance(domain);
+}
+
+// Free every retired node; only valid once no thread uses the list anymore
+static void epoch_free(Epoch_Domain* domain) {
+    for (int i = 0; i <= MAX_THREADS; i++) {
+        for (int j = 0; j < 3; j++) {
+            bag_reclaim(domain, &domain->threads[i].bags[j]);
+            free(domain->threads[i].bags[j].nodes);
+        }
+    }
+    omp_destroy_lock(&domain->overflow_lock);
+    free(domain);
+}
+
+// ======================================================================== //
+// ===================== R A N D O M   L E V E L S ======================== //
+// ======================================================================== //
+
+#define DEFAULT_P 0.5
+#define DEFAULT_SEED 0x5EED5EED5EED5EEDULL
+#define LEVEL_START 6           // levels in use when an adaptive list is created
+#define LEVEL_CHECK 64          // towers a thread draws between two updates of the list's count
+
+// Each thread draws from its own xorshift64* stream, seeded from (list seed, thread slot)
+typedef struct Rng_Slot {
+    _Alignas(CACHE_LINE) uint64_t state;
+    long draws;                                     // towers drawn less those deleted, not yet in the list's count
+    uint64_t spray;                                 // LF_SprayPopMin's stream, apart from the towers'
+} Rng_Slot;
+
+// The levels in use (top) bound both the towers drawn and where searches start. A list with
+// fixed levels uses all max_level of them; an adaptive one starts with LEVEL_START and uses
+// one more each time the towers drawn reach the next power of 1/p, so the top level stays sparse.
+struct Level_Gen {
+    Rng_Slot slots[MAX_THREADS];
+    _Alignas(CACHE_LINE) _Atomic uint64_t shared;   // stream for the threads past MAX_THREADS
+    _Atomic long towers;                            // adaptive: towers drawn, up to LEVEL_CHECK per thread behind
+    _Alignas(CACHE_LINE) _Atomic int top;           // levels in use, 1..max_level
+    int max_level;                                  // tallest tower, and the height of the head
+    bool adaptive;
+    int shift;                                      // p == 2^-shift: every run of shift zero bits is one promotion
+    uint64_t threshold;                             // any other p: promote while a draw is below p * 2^64
+    double grow[MAX_LEVEL];                         // adaptive: top moves past level l once towers >= grow[l]
+};
+
+static uint64_t splitmix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+static uint64_t xorshift64(uint64_t x) {
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    return x;
+}
+
+static Level_Gen* level_gen_init(const Skiplist_Config* config) {
+    Level_Gen* gen = (Level_Gen*)aligned_alloc(CACHE_LINE, sizeof(Level_Gen));
+    double p = config && config->p > 0 && config->p < 1 ? config->p : DEFAULT_P;
+    uint64_t seed = config && config->seed ? config->seed : DEFAULT_SEED;
+    for (int i = 0; i < MAX_THREADS; i++) {
+        gen->slots[i].state = splitmix64(seed ^ splitmix64(i)) | 1;  // xorshift state must not be 0
+        gen->slots[i].draws = 0;
+        gen->slots[i].spray = splitmix64(gen->slots[i].state) | 1;
+    }
+    atomic_init(&gen->shared, splitmix64(seed ^ splitmix64(MAX_THREADS)) | 1);
+    gen->shift = 0;
+    for (int k = 1; k <= 16; k++) {
+        if (p == 1.0 / (1 << k))
+            gen->shift = k;
+    }
+    gen->threshold = (uint64_t)(p * 18446744073709551616.0);
+    gen->max_level = config && config->max_level > 0 && config->max_level < MAX_LEVEL ? config->max_level : MAX_LEVEL;
+    gen->adaptive = !(config && config->fixed_levels);
+    atomic_init(&gen->top, gen->adaptive && LEVEL_START < gen->max_level ? LEVEL_START : gen->max_level);
+    atomic_init(&gen->towers, 0);
+    gen->grow[0] = 1;
+    for (int l = 1; l < MAX_LEVEL; l++) {
+        gen->grow[l] = gen->grow[l - 1] / p;
+    }
+    return gen;
+}
+
+static inline int levels_in_use(Level_Gen* gen) {
+    return atomic_load(&gen->top);
+}
+
+// Use at least `level` levels
+static void levels_raise(Level_Gen* gen, int level) {
+    int top = atomic_load(&gen->top);
+    while (top < level && !atomic_compare_exchange_weak(&gen->top, &top, level))
+        ;
+}
+
+// Add towers to an adaptive list's count and grow the levels in use to match
+static void levels_count(Level_Gen* gen, long towers) {
+    if (!gen->adaptive)
+        return;
+    long total = atomic_fetch_add(&gen->towers, towers) + towers;
+    int top = atomic_load(&gen->top);
+    while (top < gen->max_level && total >= gen->grow[top]) {
+        top++;
+    }
+    levels_raise(gen, top);
+}
+
+static uint64_t level_rand(Level_Gen* gen, int slot) {
+    uint64_t x;
+    if (slot < MAX_THREADS) {
+        x = gen->slots[slot].state = xorshift64(gen->slots[slot].state);
+    } else {
+        uint64_t old = atomic_load(&gen->shared);
+        do {
+            x = xorshift64(old);
+        } while (!atomic_compare_exchange_weak(&gen->shared, &old, x));
+    }
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+// Sprays draw from a stream of their own, so popping does not change the towers drawn after.
+// Threads past MAX_THREADS, whose towers are not reproducible anyway, share the towers' stream.
+static uint64_t spray_rand(Level_Gen* gen, int slot) {
+    if (slot >= MAX_THREADS)
+        return level_rand(gen, slot);
+    uint64_t x = gen->slots[slot].spray = xorshift64(gen->slots[slot].spray);
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+// Add towers drawn, or deleted if negative, to the thread's tally, and the tally to the
+// list's count once it is LEVEL_CHECK towers away from zero either way
+static void levels_tally(Level_Gen* gen, int slot, long towers) {
+    if (!gen->adaptive)
+        return;
+    if (slot >= MAX_THREADS) {
+        levels_count(gen, towers);
+        return;
+    }
+    long draws = gen->slots[slot].draws += towers;
+    if (draws >= LEVEL_CHECK || draws <= -LEVEL_CHECK) {
+        gen->slots[slot].draws = 0;
+        levels_count(gen, draws);
+    }
+}
+
+// Create an int representing the random level of the new inserted node:
+// with p = 1/2 the number of trailing zeros of one random word is the number of coin flips that came up heads
+int rand_level(Level_Gen* gen) {
+    int slot = thread_slot();
+    int top = levels_in_use(gen);
+    int level = 1;
+    if (gen->shift) {
+        level += __builtin_ctzll(level_rand(gen, slot) | (1ULL << 63)) / gen->shift;
+    } else {
+        while (level < top && level_rand(gen, slot) < gen->threshold) {
+            level++;
+        }
+    }
+    levels_tally(gen, slot, 1);
+    return level < top ? level : top;
+}
+
+// Take deleted towers off the count, so a list that shrinks grows its levels again only once
+// it holds more towers than before. The levels in use never shrink: old towers reach them.
+static void levels_deleted(Level_Gen* gen, long towers) {
+    levels_tally(gen, thread_slot(), -towers);
+}
+
+// ======================================================================== //
+// ================ C O A R S E - G R A I N E D   L O C K ================= //
+// ======================================================================== //
+
+// One lock per list. LOCK_MUTEX is a plain omp_lock_t taken by readers and writers alike.
+// LOCK_RW lets readers in on a counter in their own cache line; a writer takes the
+// mutex, raises `writer` and waits until every reader counter has drained.
+typedef struct Reader_Slot {
+    _Alignas(CACHE_LINE) _Atomic long readers;
+} Reader_Slot;
+
+struct Coarse_Lock {
+    Reader_Slot slots[MAX_THREADS + 1];     // threads past MAX_THREADS share the last one
+    _Alignas(CACHE_LINE) _Atomic bool writer;
+    Lock_Type type;
+    omp_lock_t mutex;                       // the lock itself with LOCK_MUTEX, serializes writers with LOCK_RW
+};
+
+static Coarse_Lock* coarse_lock_init(const Skiplist_Config* config) {
+    Coarse_Lock* lock = (Coarse_Lock*)aligned_alloc(CACHE_LINE, sizeof(Coarse_Lock));
+    for (int i = 0; i <= MAX_THREADS; i++) {
+        atomic_init(&lock->slots[i].readers, 0);
+    }
+    atomic_init(&lock->writer, false);
+    lock->type = config ? config->lock : LOCK_MUTEX;
+    omp_init_lock(&lock->mutex);
+    return lock;
+}
+
+static void coarse_lock_free(Coarse_Lock* lock) {
+    omp_destroy_lock(&lock->mutex);
+    free(lock);
+}
+
+// Spins briefly, then gives the core away so an oversubscribed lock holder can run
+static void lock_backoff(int* spins) {
+    if (++*spins < 64)
+        return;
+    *spins = 0;
+    sched_yield();
+}
+
+static Reader_Slot* reader_slot(Coarse_Lock* lock) {
+    return &lock->slots[thread_slot()];
+}
+
+static void read_lock(Coarse_Lock* lock) {
+    if (lock->type == LOCK_MUTEX) {
+        lock_acquire(&lock->mutex);
+        return;
+    }
+    Reader_Slot* slot = reader_slot(lock);
+    STAT_ADD(lock_acquires, 1);
+    while (true) {
+        atomic_fetch_add(&slot->readers, 1);
+        if (!atomic_load(&lock->writer))
+            return;
+        // A writer is in or waiting: back off until it is done
+        atomic_fetch_sub(&slot->readers, 1);
+        STAT_ADD(lock_contended, 1);
+        int spins = 0;
+        while (atomic_load_explicit(&lock->writer, memory_order_relaxed))
+            lock_backoff(&spins);
+    }
+}
+
+static void read_unlock(Coarse_Lock* lock) {
+    if (lock->type == LOCK_MUTEX)
+        omp_unset_lock(&lock->mutex);
+    else
+        atomic_fetch_sub_explicit(&reader_slot(lock)->readers, 1, memory_order_release);
+}
+
+static void write_lock(Coarse_Lock* lock) {
+    lock_acquire(&lock->mutex);
+    if (lock->type == LOCK_MUTEX)
+        return;
+    atomic_store(&lock->writer, true);
+    int spins = 0;
+    for (int i = 0; i <= MAX_THREADS; i++) {
+        while (atomic_load(&lock->slots[i].readers))
+            lock_backoff(&spins);
+    }
+}
+
+static void write_unlock(Coarse_Lock* lock) {
+    if (lock->type == LOCK_RW)
+        atomic_store_explicit(&lock->writer, false, memory_order_release);
+    omp_unset_lock(&lock->mutex);
+}
+
+// ======================================================================== //
+// ============================== S I Z E ================================= //
+// ======================================================================== //
+
+// Every thread adds to a counter in its own cache line; the size is their sum, exact
+// once the writers are done and approximate while they run. Threads past MAX_THREADS,
+// or of another OpenMP team, may share a slot, so the slots are still added to atomically.
+typedef struct Size_Slot {
+    _Alignas(CACHE_LINE) _Atomic long count;
+} Size_Slot;
+
+struct Size_Counter {
+    Size_Slot slots[MAX_THREADS + 1];
+};
+
+static Size_Counter* size_init(long count) {
+    Size_Counter* size = (Size_Counter*)aligned_alloc(CACHE_LINE, sizeof(Size_Counter));
+    for (int i = 0; i <= MAX_THREADS; i++) {
+        atomic_init(&size->slots[i].count, 0);
+    }
+    atomic_store(&size->slots[0].count, count);
+    return size;
+}
+
+static inline void size_add(Size_Counter* size, long delta) {
+    atomic_fetch_add_explicit(&size->slots[thread_slot()].count, delta, memory_order_relaxed);
+}
+
+static long size_sum(Size_Counter* size) {
+    long count = 0;
+    for (int i = 0; i <= MAX_THREADS; i++) {
+        count += atomic_load_explicit(&size->slots[i].count, memory_order_relaxed);
+    }
+    return count;
+}
+
+// ======================================================================== //
+// ======================== P I V O T   I N D E X ========================= //
+// ======================================================================== //
+
+// Every descent of an FGL or LF list used to start on the top levels of the head, whose
+// cache line every lock of the head invalidates in all cores. Instead a descent looks up
+// the last tower below its key in an immutable, cache-line aligned array of the towers of
+// one level (the pivots) and starts there, on that level. The array is read-only once
+// published; a new one replaces it (RCU) whenever a tower reaching the pivot level is
+// inserted or deleted, and the old one is freed two epochs later like a node.
+// A deleted pivot is dropped from the array before its node is retired, so a descent
+// only has to skip the pivots deleted since it loaded the array. A deleter never waits
+// for that: the tower goes to limbo and whoever republishes next retires it.
+
+#define PIVOT_TARGET 32         // the pivot level is the highest one with at least this many towers
+#define PIVOT_MAX 256           // towers taken from the pivot level; keys past the last one start from it
+#define PIVOT_FLOOR 4           // pivots are towers of at least this height; the others can be retired freely
+
+typedef struct Pivot_Set {
+    int level;                  // pivots reach at least level + 1; -1 when descents start at the head
+    int count;
+    int* keys;                  // ascending, the keys of nodes
+    void** nodes;
+    unsigned long retired;      // epoch the set was replaced in
+    struct Pivot_Set* next;     // replaced sets not yet freed
+} Pivot_Set;
+
+typedef struct Pivot_Limbo {
+    void* node;
+    struct Pivot_Limbo* next;
+} Pivot_Limbo;
+
+struct Pivot_Index {
+    _Alignas(CACHE_LINE) _Atomic(Pivot_Set*) current;  // read by every descent, written only on a republish
+    _Alignas(CACHE_LINE) omp_lock_t lock;               // serializes republishes
+    _Atomic bool building;                              // a republish is reading the list
+    _Atomic bool pending;                               // towers wait in limbo for a republish
+    _Atomic(Pivot_Limbo*) limbo;                        // deleted towers a published set may point to
+    void (*retire)(void* list, void* node);             // what the deleter would have done with them
+    Pivot_Set* retired;
+    int keys[PIVOT_MAX];                                // the republisher's scratch
+    void* nodes[PIVOT_MAX];
+};
+
+// The keys, then the nodes, each starting on a cache line of their own
+static Pivot_Set* pivot_set_init(int level, int count, const int* keys, void* const* nodes) {
+    size_t keys_offset = (sizeof(Pivot_Set) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    size_t nodes_offset = keys_offset + (count * sizeof(int) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    size_t bytes = nodes_offset + (count * sizeof(void*) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    Pivot_Set* set = (Pivot_Set*)aligned_alloc(CACHE_LINE, bytes);
+    set->level = level;
+    set->count = count;
+    set->keys = (int*)((char*)set + keys_offset);
+    set->nodes = (void**)((char*)set + nodes_offset);
+    memcpy(set->keys, keys, count * sizeof(int));
+    memcpy(set->nodes, nodes, count * sizeof(void*));
+    set->next = NULL;
+    return set;
+}
+
+static Pivot_Index* pivots_init(void (*retire)(void* list, void* node)) {
+    Pivot_Index* index = (Pivot_Index*)aligned_alloc(CACHE_LINE, sizeof(Pivot_Index));
+    atomic_init(&index->current, pivot_set_init(-1, 0, NULL, NULL));
+    omp_init_lock(&index->lock);
+    atomic_init(&index->building, false);
+    atomic_init(&index->pending, false);
+    atomic_init(&index->limbo, NULL);
+    index->retire = retire;
+    index->retired = NULL;
+    return index;
+}
+
+// Must be called inside a critical section of epoch, holding the index's lock
+static void pivots_publish(Pivot_Index* index, Epoch_Domain* epoch, int level, int count) {
+    Pivot_Set* old = atomic_exchange(&index->current, pivot_set_init(level, count, index->keys, index->nodes));
+    old->retired = atomic_load(&epoch->epoch);
+    old->next = index->retired;
+    index->retired = old;
+    // A descent that loaded a set is inside an epoch critical section until it is done with it
+    epoch_try_advance(epoch);
+    unsigned long now = atomic_load(&epoch->epoch);
+    for (Pivot_Set** link = &index->retired; *link;) {
+        Pivot_Set* set = *link;
+        if (set->retired + 2 <= now) {
+            *link = set->next;
+            free(set);
+        } else {
+            link = &set->next;
+        }
+    }
+}
+
+// Whether a tower of height level reaches the pivot level; only stable under the index's lock
+static inline bool pivots_may_hold(Pivot_Index* index, int level) {
+    return level >= PIVOT_FLOOR && level > atomic_load(&index->current)->level;
+}
+
+// The last pivot with a key below num, or -1
+static int pivots_below(const Pivot_Set* set, int num) {
+    int lo = 0, hi = set->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (set->keys[mid] < num)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo - 1;
+}
+
+// Called with the index's lock. The towers in limbo were marked before the list is read,
+// so the new set leaves them out and they can be retired once it is published.
+static void pivots_rebuild(Pivot_Index* index, void (*rebuild)(void* list), void* list) {
+    atomic_store(&index->pending, false);
+    Pivot_Limbo* limbo = atomic_exchange(&index->limbo, NULL);
+    atomic_store(&index->building, true);
+    rebuild(list);
+    atomic_store(&index->building, false);
+    while (limbo) {
+        Pivot_Limbo* next = limbo->next;
+        index->retire(list, limbo->node);
+        free(limbo);
+        limbo = next;
+    }
+}
+
+// Republish for the towers in limbo unless another thread holds the lock. Every holder
+// calls this after unlocking, so a tower never waits on a thread that has left.
+static void pivots_help(Pivot_Index* index, void (*rebuild)(void* list), void* list) {
+    while (atomic_load(&index->pending) && omp_test_lock(&index->lock)) {
+        pivots_rebuild(index, rebuild, list);
+        omp_unset_lock(&index->lock);
+    }
+}
+
+// After linking a tower: republish if it reaches the pivot level, unless another thread is at it
+static void pivots_linked(Pivot_Index* index, int level, void (*rebuild)(void* list), void* list) {
+    if (index && pivots_may_hold(index, level) && omp_test_lock(&index->lock)) {
+        pivots_rebuild(index, rebuild, list);
+        omp_unset_lock(&index->lock);
+        pivots_help(index, rebuild, list);
+    }
+}
+
+// After unlinking a marked tower: true if the caller can retire it. Otherwise a published
+// set may point to it, and it is left in limbo for the next republish, without waiting.
+static bool pivots_unlinked(Pivot_Index* index, void* node, int level, void (*rebuild)(void* list), void* list) {
+    if (!index || level < PIVOT_FLOOR)
+        return true;
+    // A republish reading the list may have seen the tower before it was marked. Without
+    // one, a set published since the mark was built after it, so only the current one counts.
+    if (!atomic_load(&index->building)) {
+        Pivot_Set* set = atomic_load_explicit(&index->current, memory_order_acquire);
+        if (set->level < 0 || level <= set->level)
+            return true;
+    }
+    Pivot_Limbo* entry = (Pivot_Limbo*)malloc(sizeof(Pivot_Limbo));
+    entry->node = node;
+    entry->next = atomic_load(&index->limbo);
+    while (!atomic_compare_exchange_weak(&index->limbo, &entry->next, entry))
+        ;
+    atomic_store(&index->pending, true);
+    pivots_help(index, rebuild, list);
+    return false;
+}
+
+// A bulk load publishes the pivots of the whole list at once
+static void pivots_built(Pivot_Index* index, Epoch_Domain* epoch, void (*rebuild)(void* list), void* list) {
+    if (!index)
+        return;
+    epoch_enter(epoch);
+    omp_set_lock(&index->lock);
+    pivots_rebuild(index, rebuild, list);
+    omp_unset_lock(&index->lock);
+    pivots_help(index, rebuild, list);
+    epoch_exit(epoch);
+}
+
+// Before the list's epoch is freed: the towers still in limbo are not on any level anymore
+static void pivots_free(Pivot_Index* index, void* list) {
+    if (!index)
+        return;
+    for (Pivot_Limbo* limbo = atomic_load(&index->limbo); limbo;) {
+        Pivot_Limbo* next = limbo->next;
+        index->retire(list, limbo->node);
+        free(limbo);
+        limbo = next;
+    }
+    free(atomic_load(&index->current));
+    while (index->retired) {
+        Pivot_Set* set = index->retired;
+        index->retired = set->next;
+        free(set);
+    }
+    omp_destroy_lock(&index->lock);
+    free(index);
+}
+
+// ======================================================================== //
+// ============================== K E Y S ================================= //
+// ======================================================================== //
+
+// Lists created with a comparator or fixed-width byte keys compare through here
+static int key_compare(const Skiplist* sl, int64_t a, int64_t b) {
+    if (sl->key_width)
+        return memcmp((const void*)(intptr_t)a, (const void*)(intptr_t)b, sl->key_width);
+    return sl->cmp(a, b);
+}
+
+// `custom` is read from the list once per operation, so integer keys keep a plain inlined comparison
+static inline bool key_less(const Skiplist* sl, bool custom, int64_t a, int64_t b) {
+    return custom ? key_compare(sl, a, b) < 0 : a < b;
+}
+
+static inline bool key_equal(const Skiplist* sl, bool custom, int64_t a, int64_t b) {
+    return custom ? key_compare(sl, a, b) == 0 : a == b;
+}
+
+// ======================================================================== //
+// ========================== S I M D   R A N K =========================== //
+// ======================================================================== //
+
+// The rank of a probe among sorted keys is the number of keys less than it: one vector
+// compare per 8 int (AVX2) or 4 int64_t keys, and a popcount of the movemask, with no
+// branch on the data. Chunks and snapshot index levels are searched this way, with the
+// widest kernel the CPU supports, picked once at startup.
+
+typedef int (*Rank32_Fn)(const int* keys, int n, int num);
+typedef size_t (*Rank64_Fn)(const int64_t* keys, size_t n, int64_t key);
+
+static int rank32_scalar(const int* keys, int n, int num) {
+    int rank = 0;
+    while (rank < n && keys[rank] < num) {
+        rank++;
+    }
+    return rank;
+}
+
+static size_t rank64_scalar(const int64_t* keys, size_t n, int64_t key) {
+    size_t rank = 0;
+    while (rank < n && keys[rank] < key) {
+        rank++;
+    }
+    return rank;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse4.2,popcnt")))
+static int rank32_sse42(const int* keys, int n, int num) {
+    __m128i probe = _mm_set1_epi32(num);
+    int rank = 0, i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i less = _mm_cmpgt_epi32(probe, _mm_loadu_si128((const __m128i*)(keys + i)));
+        rank += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(less)));
+    }
+    return rank + rank32_scalar(keys + i, n - i, num);
+}
+
+__attribute__((target("avx2,popcnt")))
+static int rank32_avx2(const int* keys, int n, int num) {
+    __m256i probe = _mm256_set1_epi32(num);
+    int rank = 0, i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i less = _mm256_cmpgt_epi32(probe, _mm256_loadu_si256((const __m256i*)(keys + i)));
+        rank += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(less)));
+    }
+    return rank + rank32_scalar(keys + i, n - i, num);
+}
+
+__attribute__((target("sse4.2,popcnt")))
+static size_t rank64_sse42(const int64_t* keys, size_t n, int64_t key) {
+    __m128i probe = _mm_set1_epi64x(key);
+    size_t rank = 0, i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m128i less = _mm_cmpgt_epi64(probe, _mm_loadu_si128((const __m128i*)(keys + i)));
+        rank += __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(less)));
+    }
+    return rank + rank64_scalar(keys + i, n - i, key);
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t rank64_avx2(const int64_t* keys, size_t n, int64_t key) {
+    __m256i probe = _mm256_set1_epi64x(key);
+    size_t rank = 0, i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i less = _mm256_cmpgt_epi64(probe, _mm256_loadu_si256((const __m256i*)(keys + i)));
+        rank += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(less)));
+    }
+    return rank + rank64_scalar(keys + i, n - i, key);
+}
+#endif
+
+static Rank_Kernel best_kernel = RANK_SCALAR;
+static Rank32_Fn rank32 = rank32_scalar;
+static Rank64_Fn rank64 = rank64_scalar;
+
+__attribute__((constructor))
+static void rank_select(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+        best_kernel = RANK_AVX2;
+        rank32 = rank32_avx2;
+        rank64 = rank64_avx2;
+    } else if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt")) {
+        best_kernel = RANK_SSE42;
+        rank32 = rank32_sse42;
+        rank64 = rank64_sse42;
+    }
+#endif
+}
+
+Rank_Kernel rank_kernel() {
+    return best_kernel;
+}
+
+// Kernels past the one the CPU supports fall back to it
+int rank_keys(Rank_Kernel kernel, const int* keys, int n, int num) {
+#if defined(__x86_64__) || defined(__i386__)
+    kernel = kernel < best_kernel ? kernel : best_kernel;
+    if (kernel == RANK_AVX2)
+        return rank32_avx2(keys, n, num);
+    if (kernel == RANK_SSE42)
+        return rank32_sse42(keys, n, num);
+#endif
+    (void)kernel;
+    return rank32_scalar(keys, n, num);
+}
+
+// ======================================================================== //
+// ========================= S N A P S H O T S ============================ //
+// ======================================================================== //
+
+// On-disk format, native byte order: a header, the sorted keys (level 0), a sampled index
+// where level i holds every SNAPSHOT_FANOUT^i-th key, and one 64-bit word of value per key.
+// Every array starts on a cache line. A list opened from a snapshot searches the mapped
+// arrays in place; its own towers are an overlay holding the writes since, where a node
+// whose value is TOMBSTONE hides a deleted snapshot key.
+
+#define SNAPSHOT_MAGIC "SKIPSNAP"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_FANOUT 16
+#define SNAPSHOT_LEVELS 16      // FANOUT^16 keys is more than a file can hold
+
+static char tombstone;
+#define TOMBSTONE ((void*)&tombstone)
+
+typedef struct Snapshot_Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t levels;                            // level 0 is every key
+    uint64_t count[SNAPSHOT_LEVELS];
+    uint64_t offset[SNAPSHOT_LEVELS];           // from the start of the file
+    uint64_t values_offset;
+    uint64_t keys_checksum;                     // level 0
+    uint64_t index_checksum;                    // levels 1 and up
+    uint64_t values_checksum;
+    uint64_t header_checksum;                   // of the header with this field set to 0
+} Snapshot_Header;
+
+struct Snapshot {
+    void* map;
+    size_t size;
+    const Snapshot_Header* header;
+    const int64_t* level_keys[SNAPSHOT_LEVELS];
+    const uint64_t* values;
+    size_t count;                               // keys on level 0
+};
+
+// Word-at-a-time multiply-xor hash; every checksummed range is a multiple of 8 bytes
+static uint64_t snapshot_checksum(const void* data, size_t bytes) {
+    const uint64_t* words = (const uint64_t*)data;
+    uint64_t hash = 0x9E3779B97F4A7C15ULL ^ bytes;
+    for (size_t i = 0; i < bytes / 8; i++) {
+        hash = (hash ^ words[i]) * 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+static uint64_t snapshot_index_checksum(const Snapshot_Header* header, const int64_t* const* level_keys) {
+    uint64_t hash = 0;
+    for (uint32_t level = 1; level < header->levels; level++) {
+        hash = hash * 31 + snapshot_checksum(level_keys[level], header->count[level] * sizeof(int64_t));
+    }
+    return hash;
+}
+
+// Position of the first snapshot key not less than key: a scan of at most
+// SNAPSHOT_FANOUT keys per level, starting below the predecessor on the level above
+static size_t snapshot_lower_bound(const Snapshot* snap, int64_t key) {
+    int top = (int)snap->header->levels - 1;
+    size_t pos = 0;
+    for (int level = top; level >= 0; level--) {
+        const int64_t* keys = snap->level_keys[level];
+        size_t count = snap->header->count[level];
+        size_t end = level == top || pos + SNAPSHOT_FANOUT > count ? count : pos + SNAPSHOT_FANOUT;
+        pos += rank64(keys + pos, end - pos, key);
+        if (level > 0)
+            pos = pos ? (pos - 1) * SNAPSHOT_FANOUT : 0;
+    }
+    return pos;
+}
+
+static bool snapshot_get(const Snapshot* snap, int64_t key, void** value) {
+    size_t pos = snapshot_lower_bound(snap, key);
+    if (pos == snap->count || snap->level_keys[0][pos] != key)
+        return false;
+    if (value)
+        *value = (void*)(uintptr_t)snap->values[pos];
+    return true;
+}
+
+// Map a snapshot file and check its header and index; the keys and values are only
+// read when they are first searched. Returns NULL if the file is not a valid snapshot.
+static Snapshot* snapshot_map(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Snapshot_Header)) {
+        close(fd);
+        return NULL;
+    }
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    Snapshot_Header header = *(const Snapshot_Header*)map;
+    uint64_t stored = header.header_checksum;
+    header.header_checksum = 0;
+    bool valid = memcmp(header.magic, SNAPSHOT_MAGIC, 8) == 0 && header.version == SNAPSHOT_VERSION &&
+                 header.levels >= 1 && header.levels <= SNAPSHOT_LEVELS &&
+                 snapshot_checksum(&header, sizeof(header)) == stored;
+    // Offsets and counts are checked apart, as offset + count * 8 could wrap around
+    uint64_t file_size = (uint64_t)st.st_size;
+    for (uint32_t level = 0; valid && level < header.levels; level++) {
+        valid = header.offset[level] % sizeof(int64_t) == 0 && header.offset[level] <= file_size &&
+                header.count[level] <= (file_size - header.offset[level]) / sizeof(int64_t);
+    }
+    valid = valid && header.values_offset % sizeof(uint64_t) == 0 && header.values_offset <= file_size &&
+            header.count[0] <= (file_size - header.values_offset) / sizeof(uint64_t);
+
+    Snapshot* snap = (Snapshot*)calloc(1, sizeof(Snapshot));
+    snap->map = map;
+    snap->size = st.st_size;
+    snap->header = (const Snapshot_Header*)map;
+    if (valid) {
+        for (uint32_t level = 0; level < header.levels; level++) {
+            snap->level_keys[level] = (const int64_t*)((const char*)map + header.offset[level]);
+        }
+        snap->values = (const uint64_t*)((const char*)map + header.values_offset);
+        snap->count = header.count[0];
+        valid = snapshot_index_checksum(&header, snap->level_keys) == header.index_checksum;
+    }
+    if (!valid) {
+        munmap(map, st.st_size);
+        free(snap);
+        return NULL;
+    }
+    return snap;
+}
+
+static void snapshot_unmap(Snapshot* snap) {
+    munmap(snap->map, snap->size);
+    free(snap);
+}
+
+// ======================================================================== //
+// ==================== W R I T E - A H E A D   L O G ===================== //
+// ======================================================================== //
+
+// A list opened with skiplist_open_wal appends one record per successful write to a
+// buffer of the writing thread; a flusher thread drains every buffer, writes the records
+// and fsyncs them as one group. Records carry a global sequence number, taken while the
+// write still holds the list (or its CGL lock), so replay can restore their order.
+// The file holds them in that order without gaps, so a crash can only cut off its tail.
+
+#define WAL_MAGIC "SKIPLWAL"
+#define WAL_VERSION 2
+#define WAL_GROUP 64            // default records per fsync
+#define WAL_INTERVAL_NS 1000000 // a partial group waits at most this long for its fsync
+
+typedef enum Wal_Op {
+    WAL_INSERT,                 // Insert: a new tower, even over an equal key
+    WAL_PUT,                    // Put: replace the value of the key or add it
+    WAL_DELETE                  // Remove of one tower with the key
+} Wal_Op;
+
+typedef struct Wal_Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t reserved[2];
+} Wal_Header;
+
+typedef struct Wal_Record {
+    uint64_t lsn;
+    uint32_t op;
+    uint32_t checksum;          // of the other fields
+    int64_t key;
+    uint64_t value;             // raw 64-bit word, like snapshot values
+} Wal_Record;
+
+static uint32_t wal_checksum(const Wal_Record* rec) {
+    uint64_t words[4] = { rec->lsn, rec->op, (uint64_t)rec->key, rec->value };
+    return (uint32_t)snapshot_checksum(words, sizeof(words));
+}
+
+// One per thread, on its own cache line; the owner appends, the flusher drains
+typedef struct Wal_Buffer {
+    _Alignas(CACHE_LINE) pthread_mutex_t lock;
+    Wal_Record* records;
+    size_t count;
+    size_t capacity;
+} Wal_Buffer;
+
+struct Wal {
+    Wal_Buffer buffers[MAX_THREADS + 1];
+    int fd;
+    size_t group;
+    _Atomic uint64_t lsn;       // of the next record
+    _Atomic size_t pending;     // appended, not yet drained
+    pthread_t flusher;
+    pthread_mutex_t mutex;      // guards the fields below and the flusher's sleep
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    uint64_t requested;         // skiplist_wal_sync tickets handed out ...
+    uint64_t completed;         // ... and served by a finished flush
+    bool stop;
+    bool failed;                // a write or fsync failed; the log is no longer durable
+    Wal_Record* out;            // flusher only: the records of one group
+    size_t out_capacity;
+    size_t held;                // flusher only: records drained before one they follow
+    uint64_t written;           // flusher only: sequence number of the next record to write
+};
+
+static void wal_append(Wal* wal, Wal_Op op, int64_t key, void* value) {
+    Wal_Buffer* buf = &wal->buffers[thread_slot()];
+    pthread_mutex_lock(&buf->lock);
+    if (buf->count == buf->capacity) {
+        buf->capacity = buf->capacity ? buf->capacity * 2 : 256;
+        buf->records = (Wal_Record*)realloc(buf->records, buf->capacity * sizeof(Wal_Record));
+    }
+    Wal_Record* rec = &buf->records[buf->count++];
+    rec->lsn = atomic_fetch_add(&wal->lsn, 1);
+    rec->op = op;
+    rec->key = key;
+    rec->value = (uint64_t)(uintptr_t)value;
+    rec->checksum = wal_checksum(rec);
+    pthread_mutex_unlock(&buf->lock);
+    // Wake the flusher once per full group; it also wakes on its own every WAL_INTERVAL_NS
+    if (atomic_fetch_add(&wal->pending, 1) + 1 == wal->group) {
+        pthread_mutex_lock(&wal->mutex);
+        pthread_cond_signal(&wal->wake);
+        pthread_mutex_unlock(&wal->mutex);
+    }
+}
+
+static inline void wal_log(Skiplist* sl, Wal_Op op, int64_t key, void* value) {
+    if (sl->wal)
+        wal_append(sl->wal, op, key, value);
+}
+
+// An indexed list stores the span of every forward pointer, the number of bottom level
+// steps it skips, right behind the pointers. Spans of NULL pointers are never read.
+static inline long* node_spans(Node* node) {
+    return (long*)(node->next + node->level);
+}
+
+static size_t node_size(const Skiplist* sl, int level) {
+    return sizeof(Node) + level * (sizeof(Node*) + (sl->indexed ? sizeof(long) : 0));
+}
+
+// Initialize a sequential/coarse-grained lock node: one allocation per key, a tower of `level` forward pointers
+Node* node_init(Skiplist* sl, int64_t key, void* value, int level) {
+    Node* newNode = (Node*)node_alloc(sl->alloc, node_size(sl, level));
+    newNode->key = key;
+    newNode->value = value;
+    newNode->level = level;
+    for (int i = 0; i < level; i++) {
+        newNode->next[i] = NULL;
+    }
+    if (sl->indexed)
+        memset(node_spans(newNode), 0, level * sizeof(long));
+    return newNode;
+}
+
+static void node_reclaim(void* list, void* node) {
+    Node* del = (Node*)node;
+    node_free(((Skiplist*)list)->alloc, del, node_size((Skiplist*)list, del->level));
+}
+
+// Initialize a sequential/coarse-grained lock skip list: the head is a full height tower
+// told apart by its address, never by its key, so every int64_t is a valid key
+Skiplist* skiplist_init_with(const Skiplist_Config* config) {
+    Skiplist* sl = (Skiplist*)malloc(sizeof(Skiplist));
+    sl->alloc = allocator_init(config);
+    sl->epoch = epoch_init(node_reclaim, sl);
+    sl->levels = level_gen_init(config);
+    sl->cmp = config ? config->cmp : NULL;
+    sl->key_width = config ? config->key_width : 0;
+    sl->lock = coarse_lock_init(config);
+    sl->base = NULL;
+    sl->wal = NULL;
+    sl->size = size_init(0);
+    sl->indexed = config && config->indexed;
+    sl->head = node_init(sl, 0, NULL, sl->levels->max_level);
+    return sl;
+}
+
+Skiplist* skiplist_init() {
+    return skiplist_init_with(NULL);
+}
+
+// Initiation for fine-grained lock node: 
+FGL_Node* fgl_node_init(Node_Allocator* alloc, int val, int level) {
+    FGL_Node* newNode = (FGL_Node*)node_alloc(alloc, sizeof(FGL_Node) + level * sizeof(FGL_Node*));
     newNode->val = val;
-    newNode->right = NULL;
-    newNode->down = NULL;
+    newNode->level = level;
+    omp_init_lock(&newNode->lock);
+    atomic_init(&newNode->marked, false);
+    atomic_init(&newNode->fully_linked, false);
+    for (int i = 0; i < level; i++) {
+        atomic_init(&newNode->next[i], NULL);
+    }
     return newNode;
 }
 
-// Initialize a sequential/coarse-grained lock skip list
-Skiplist* skiplist_init() {
-    Skiplist* sl = (Skiplist*)malloc(sizeof(Skiplist));
-    sl->head = node_init(-MAX_INT);
-    return sl;
+static void fgl_node_reclaim(void* list, void* node) {
+    FGL_Node* del = (FGL_Node*)node;
+    omp_destroy_lock(&del->lock);
+    node_free(((FGL_Skiplist*)list)->alloc, del, sizeof(FGL_Node) + del->level * sizeof(FGL_Node*));
+}
+
+// A deleted tower the pivot index held on to
+static void fgl_node_retire(void* list, void* node) {
+    epoch_retire(((FGL_Skiplist*)list)->epoch, node);
+}
+
+// Initiation for fine-grained lock skip list: 
+// A shard passes the NUMA node its slabs, the head's included, are bound to; others pass -1
+static FGL_Skiplist* fgl_skiplist_create(const Skiplist_Config* config, int numa_node) {
+    FGL_Skiplist* sl = (FGL_Skiplist*)malloc(sizeof(FGL_Skiplist));
+    sl->alloc = allocator_init(config);
+    sl->alloc->numa_node = numa_node;
+    sl->epoch = epoch_init(fgl_node_reclaim, sl);
+    sl->levels = level_gen_init(config);
+    sl->size = size_init(0);
+    sl->pivots = config && config->head_only ? NULL : pivots_init(fgl_node_retire);
+    sl->head = fgl_node_init(sl->alloc, -MAX_INT, sl->levels->max_level);
+    atomic_store(&sl->head->fully_linked, true);
+    return sl;
+}
+
+FGL_Skiplist* fgl_skiplist_init_with(const Skiplist_Config* config) {
+    return fgl_skiplist_create(config, -1);
+}
+
+FGL_Skiplist* fgl_skiplist_init() {
+    return fgl_skiplist_init_with(NULL);
+}
+
+// Marked pointers for the lock-free version: the low bit of a forward pointer
+// tells that the node owning it has been logically deleted at that level
+#define LF_MARK(p)      ((uintptr_t)(p) | 1)
+#define LF_UNMARK(p)    ((LF_Node*)((uintptr_t)(p) & ~(uintptr_t)1))
+#define LF_MARKED(p)    ((uintptr_t)(p) & 1)
+
+// Initiation for lock-free node: a tower with one forward pointer per level
+LF_Node* lf_node_init(Node_Allocator* alloc, int val, int level) {
+    LF_Node* newNode = (LF_Node*)node_alloc(alloc, sizeof(LF_Node) + level * sizeof(_Atomic uintptr_t));
+    newNode->val = val;
+    newNode->level = level;
+    atomic_init(&newNode->votes, 0);
+    for (int i = 0; i < level; i++) {
+        atomic_init(&newNode->next[i], (uintptr_t)NULL);
+    }
+    return newNode;
+}
+
+// Initiation for lock-free skip list: the head is a full height tower whose val is never compared
+static void lf_node_reclaim(void* list, void* node) {
+    LF_Node* del = (LF_Node*)node;
+    node_free(((LF_Skiplist*)list)->alloc, del, sizeof(LF_Node) + del->level * sizeof(_Atomic uintptr_t));
+}
+
+// Both the inserter and the deleter of a node cast one vote once they stop
+// touching its forward pointers; the second vote retires it
+static void lf_retire_vote(LF_Skiplist* sl, LF_Node* node) {
+    if (atomic_fetch_add(&node->votes, 1) == 1)
+        epoch_retire(sl->epoch, node);
+}
+
+// The deleter's vote on a tower the pivot index held on to
+static void lf_node_retire(void* list, void* node) {
+    lf_retire_vote((LF_Skiplist*)list, (LF_Node*)node);
+}
+
+LF_Skiplist* lf_skiplist_init_with(const Skiplist_Config* config) {
+    LF_Skiplist* sl = (LF_Skiplist*)malloc(sizeof(LF_Skiplist));
+    sl->alloc = allocator_init(config);
+    sl->epoch = epoch_init(lf_node_reclaim, sl);
+    sl->levels = level_gen_init(config);
+    sl->size = size_init(0);
+    sl->pivots = config && config->head_only ? NULL : pivots_init(lf_node_retire);
+    sl->head = lf_node_init(sl->alloc, -MAX_INT, sl->levels->max_level);
+    return sl;
+}
+
+LF_Skiplist* lf_skiplist_init() {
+    return lf_skiplist_init_with(NULL);
+}
+
+// ======================================================================== //
+// ============================= S E A R C H ============================== //
+// ======================================================================== //
+
+// Get is read-only so it can be used in parallel without synchronizaton;
+// the epoch critical section keeps the nodes it stands on from being freed by a concurrent delete
+bool Get(Skiplist* sl, int64_t key, void** value) {
+    STAT_TIMER(start);
+    bool custom = sl->cmp || sl->key_width;
+    Node* found = NULL;
+    epoch_enter(sl->epoch);
+    Node* temp = sl->head;
+    for (int level = levels_in_use(sl->levels) - 1; level >= 0 && !found; level--) {
+        while (temp->next[level] && key_less(sl, custom, temp->next[level]->key, key)) {
+            STAT_VISIT(level);
+            temp = temp->next[level];
+        }
+        if (temp->next[level] && key_equal(sl, custom, temp->next[level]->key, key))
+            found = temp->next[level];
+    }
+    // The overlay shadows the snapshot below it, if any
+    bool present = found ? found->value != TOMBSTONE : sl->base && snapshot_get(sl->base, key, value);
+    if (found && present && value)
+        *value = found->value;
+    epoch_exit(sl->epoch);
+    STAT_OP(STAT_SEARCH, start);
+    return present;
+}
+
+bool Search(Skiplist* sl, int num) {
+    return Get(sl, num, NULL);
+}
+
+#define SEARCH_GROUP 16         // lookups in flight in SearchBatch
+
+// One lookup in flight: the tower it stands on and the level it walks
+typedef struct Search_State {
+    size_t index;
+    Node* temp;
+    int level;
+} Search_State;
+
+// Look up every key like Search, interleaving up to SEARCH_GROUP descents (AMAC): each step
+// of a descent prefetches the node its next step compares against, and the other descents
+// take their steps while that line is on its way, so one thread keeps several misses in flight
+void SearchBatch(Skiplist* sl, const int64_t* keys, size_t n, bool* results) {
+    bool custom = sl->cmp || sl->key_width;
+    Search_State group[SEARCH_GROUP];
+    size_t issued = 0;
+    int active = 0;
+    epoch_enter(sl->epoch);
+    int top = levels_in_use(sl->levels) - 1;
+    __builtin_prefetch(sl->head->next[top]);
+    while (active < SEARCH_GROUP && issued < n) {
+        group[active++] = (Search_State){ issued++, sl->head, top };
+    }
+    while (active > 0) {
+        for (int g = 0; g < active; g++) {
+            Search_State* state = &group[g];
+            int64_t key = keys[state->index];
+            Node* next = state->temp->next[state->level];
+            if (next && key_less(sl, custom, next->key, key)) {
+                STAT_VISIT(state->level);
+                state->temp = next;
+                __builtin_prefetch(next->next[state->level]);
+                continue;
+            }
+            bool found = next && key_equal(sl, custom, next->key, key);
+            if (!found && state->level > 0) {
+                state->level--;
+                __builtin_prefetch(state->temp->next[state->level]);
+                continue;
+            }
+            // The overlay shadows the snapshot below it, if any
+            results[state->index] = found ? next->value != TOMBSTONE : sl->base && snapshot_get(sl->base, key, NULL);
+            if (issued < n) {
+                *state = (Search_State){ issued++, sl->head, top };
+            } else {
+                *state = group[--active];
+                g--;
+            }
+        }
+    }
+    epoch_exit(sl->epoch);
+}
+
+// ======================================================================== //
+// ================= C O A R S E  L O C K  S E A R C H ==================== //
+// ======================================================================== //
+
+// Takes the read side of the list's lock, so it never overlaps a CGL writer
+bool CGL_Get(Skiplist* sl, int64_t key, void** value) {
+    read_lock(sl->lock);
+    bool found = Get(sl, key, value);
+    read_unlock(sl->lock);
+    return found;
+}
+
+bool CGL_Search(Skiplist* sl, int num) {
+    return CGL_Get(sl, num, NULL);
+}
+
+// ======================================================================== //
+// ========= F I N E - G R A I N E D  L O C K  S E A R C H ================ //
+// ======================================================================== //
+
+// Lazy synchronization (Herlihy, Lev, Luchangco, Shavit): traversals take no locks,
+// writers lock only the predecessors at the insertion/removal point and validate them.
+// Pick the pivots from the highest level with PIVOT_TARGET live towers; called with the index's lock
+static void fgl_pivots_rebuild(void* list) {
+    FGL_Skiplist* sl = (FGL_Skiplist*)list;
+    Pivot_Index* index = sl->pivots;
+    for (int level = levels_in_use(sl->levels) - 1; level >= PIVOT_FLOOR - 1; level--) {
+        int count = 0;
+        FGL_Node* node = atomic_load(&sl->head->next[level]);
+        for (; node && count < PIVOT_MAX; node = atomic_load(&node->next[level])) {
+            if (atomic_load(&node->fully_linked) && !atomic_load(&node->marked)) {
+                index->keys[count] = node->val;
+                index->nodes[count++] = node;
+            }
+        }
+        if (count >= PIVOT_TARGET) {
+            pivots_publish(index, sl->epoch, level, count);
+            return;
+        }
+    }
+    if (atomic_load(&index->current)->level >= 0)
+        pivots_publish(index, sl->epoch, -1, 0);
+}
+
+// Where a descent for num starts: the last pivot below num that is not deleted, on the pivot
+// level. A caller linking a tower above that level needs the head's levels too.
+static FGL_Node* fgl_start(FGL_Skiplist* sl, int num, int height, int* start) {
+    *start = levels_in_use(sl->levels) - 1;
+    if (!sl->pivots)
+        return sl->head;
+    Pivot_Set* set = atomic_load_explicit(&sl->pivots->current, memory_order_acquire);
+    if (set->level < 0 || height > set->level + 1)
+        return sl->head;
+    if (set->level < *start)
+        *start = set->level;
+    for (int i = pivots_below(set, num); i >= 0; i--) {
+        FGL_Node* pivot = (FGL_Node*)set->nodes[i];
+        if (!atomic_load(&pivot->marked))
+            return pivot;
+    }
+    return sl->head;
+}
+
+// Find the predecessor and successor of num on every level.
+// With a finger, preds holds the predecessors of a smaller key on input and each level
+// starts from there when that node is further right and not deleted. Without one the
+// descent starts at a pivot; height is the levels whose preds the caller will link.
+// Returns the highest level on which a node with val == num was found, or -1.
+static int fgl_find(FGL_Skiplist* sl, int num, FGL_Node** preds, FGL_Node** succs, bool finger, int height) {
+    int top = levels_in_use(sl->levels);
+    int found = -1, start = top - 1;
+    FGL_Node* pred = finger ? sl->head : fgl_start(sl, num, height, &start);
+    for (int level = top - 1; level > start; level--) {
+        preds[level] = sl->head;        // so the next key of a batch can use them as a finger
+        succs[level] = NULL;
+    }
+    for (int level = start; level >= 0; level--) {
+        if (finger && preds[level]->val > pred->val && !atomic_load(&preds[level]->marked))
+            pred = preds[level];
+        FGL_Node* curr = atomic_load(&pred->next[level]);
+        while (curr && curr->val < num) {
+            STAT_VISIT(level);
+            pred = curr;
+            curr = atomic_load(&pred->next[level]);
+        }
+        if (found == -1 && curr && curr->val == num)
+            found = level;
+        preds[level] = pred;
+        succs[level] = curr;
+    }
+    // A tower reaching the pivot level may be taller; a delete needs its preds on every level.
+    // The levels in use may have grown since: the finger of the new ones is the head.
+    if (found == start && start < top - 1) {
+        for (int level = top; level < MAX_LEVEL; level++) {
+            preds[level] = sl->head;
+        }
+        return fgl_find(sl, num, preds, succs, true, height);
+    }
+    return found;
+}
+
+// Wait-free: never locks and never retries
+bool FGL_Search(FGL_Skiplist* sl, int num) {
+    STAT_TIMER(start);
+    FGL_Node* preds[MAX_LEVEL];
+    FGL_Node* succs[MAX_LEVEL];
+    epoch_enter(sl->epoch);
+    int found = fgl_find(sl, num, preds, succs, false, 0);
+    bool flag = found != -1 && atomic_load(&succs[found]->fully_linked) && !atomic_load(&succs[found]->marked);
+    epoch_exit(sl->epoch);
+    STAT_OP(STAT_SEARCH, start);
+    return flag;
+}
+
+// ======================================================================== //
+// ================ L O C K - F R E E  S E A R C H ======================== //
+// ======================================================================== //
+
+// Pick the pivots from the highest level with PIVOT_TARGET live towers; called with the index's lock
+static void lf_pivots_rebuild(void* list) {
+    LF_Skiplist* sl = (LF_Skiplist*)list;
+    Pivot_Index* index = sl->pivots;
+    for (int level = levels_in_use(sl->levels) - 1; level >= PIVOT_FLOOR - 1; level--) {
+        int count = 0;
+        LF_Node* node = LF_UNMARK(atomic_load(&sl->head->next[level]));
+        for (; node && count < PIVOT_MAX; node = LF_UNMARK(atomic_load(&node->next[level]))) {
+            if (!LF_MARKED(atomic_load(&node->next[level])) && !LF_MARKED(atomic_load(&node->next[0]))) {
+                index->keys[count] = node->val;
+                index->nodes[count++] = node;
+            }
+        }
+        if (count >= PIVOT_TARGET) {
+            pivots_publish(index, sl->epoch, level, count);
+            return;
+        }
+    }
+    if (atomic_load(&index->current)->level >= 0)
+        pivots_publish(index, sl->epoch, -1, 0);
+}
+
+// Where a descent for num starts: the last pivot below num not deleted on the pivot level,
+// which is as good as having reached it from the head. A caller linking or unlinking a
+// tower above that level needs the head's levels too.
+static LF_Node* lf_start(LF_Skiplist* sl, int num, int height, int* start) {
+    *start = levels_in_use(sl->levels) - 1;
+    if (!sl->pivots)
+        return sl->head;
+    Pivot_Set* set = atomic_load_explicit(&sl->pivots->current, memory_order_acquire);
+    if (set->level < 0 || height > set->level + 1)
+        return sl->head;
+    if (set->level < *start)
+        *start = set->level;
+    for (int i = pivots_below(set, num); i >= 0; i--) {
+        LF_Node* pivot = (LF_Node*)set->nodes[i];
+        if (!LF_MARKED(atomic_load(&pivot->next[*start])))
+            return pivot;
+    }
+    return sl->head;
+}
+
+// Wait-free: marked nodes are stepped over instead of being unlinked, so the
+// search never retries and never writes to shared memory.
+// Returns the first node on the bottom level with val >= num that was not deleted when reached.
+static LF_Node* lf_locate(LF_Skiplist* sl, int num) {
+    int start;
+    LF_Node* pred = lf_start(sl, num, 0, &start);
+    LF_Node* curr = NULL;
+    for (int level = start; level >= 0; level--) {
+        curr = LF_UNMARK(atomic_load(&pred->next[level]));
+        while (curr) {
+            uintptr_t succ = atomic_load(&curr->next[level]);
+            // Skip the nodes that are logically deleted at this level
+            while (curr && LF_MARKED(succ)) {
+                curr = LF_UNMARK(succ);
+                if (curr)
+                    succ = atomic_load(&curr->next[level]);
+            }
+            if (curr && curr->val < num) {
+                STAT_VISIT(level);
+                pred = curr;
+                curr = LF_UNMARK(succ);
+            } else {
+                break;
+            }
+        }
+    }
+    return curr;
+}
+
+bool LF_Search(LF_Skiplist* sl, int num) {
+    STAT_TIMER(start);
+    epoch_enter(sl->epoch);
+    LF_Node* curr = lf_locate(sl, num);
+    bool found = curr && curr->val == num;
+    epoch_exit(sl->epoch);
+    STAT_OP(STAT_SEARCH, start);
+    return found;
+}
+
+// ======================================================================== //
+// ============================= I N S E R T ============================== //
+// ======================================================================== //
+
+// Link a new tower behind preds into every level it reaches. preds holds the `top` levels
+// searched; if the levels in use grew since, the new levels above them are still empty.
+// In an indexed list ranks[l] is the position of preds[l], the head being position 0.
+static void link_tower(Skiplist* sl, Node** preds, const long* ranks, int top, int64_t key, void* value) {
+    int randLevel = rand_level(sl->levels);
+    Node* newNode = node_init(sl, key, value, randLevel);
+    for (int level = 0; level < randLevel; level++) {
+        Node* pred = level < top ? preds[level] : sl->head;
+        newNode->next[level] = pred->next[level];
+        pred->next[level] = newNode;
+    }
+    if (!sl->indexed)
+        return;
+    // Links the tower cuts in two share their span with it; the ones above it skip one more node
+    long rank = ranks[0] + 1;
+    for (int level = 0; level < randLevel || level < top; level++) {
+        long* spans = node_spans(level < top ? preds[level] : sl->head);
+        long pred_rank = level < top ? ranks[level] : 0;
+        if (level < randLevel) {
+            node_spans(newNode)[level] = spans[level] - (rank - pred_rank) + 1;
+            spans[level] = rank - pred_rank;
+        } else {
+            spans[level]++;
+        }
+    }
+}
+
+// Link a new tower in front of the first one with an equal or greater key.
+// With `replace`, an existing tower with the same key gets the new value instead.
+static bool skiplist_insert(Skiplist* sl, int64_t key, void* value, bool replace) {
+    bool custom = sl->cmp || sl->key_width;
+    Node* preds[MAX_LEVEL];
+    long ranks[MAX_LEVEL];
+    long rank = 0;
+    epoch_enter(sl->epoch);
+    Node* temp = sl->head;
+    int top = levels_in_use(sl->levels);
+    for (int level = top - 1; level >= 0; level--) {
+        // Find the correct position by moving right
+        while (temp->next[level] && key_less(sl, custom, temp->next[level]->key, key)) {
+            STAT_VISIT(level);
+            if (sl->indexed)
+                rank += node_spans(temp)[level];
+            temp = temp->next[level];
+        }
+        preds[level] = temp;
+        ranks[level] = rank;
+    }
+    Node* next = temp->next[0];
+    if ((replace || sl->base) && next && key_equal(sl, custom, next->key, key)) {
+        // Over a snapshot the overlay holds at most one node per key, maybe a tombstone
+        bool revived = next->value == TOMBSTONE;
+        if (replace || revived) {
+            next->value = value;
+            wal_log(sl, replace ? WAL_PUT : WAL_INSERT, key, value);
+        }
+        if (revived)
+            size_add(sl->size, 1);
+        epoch_exit(sl->epoch);
+        return revived;
+    }
+    bool in_base = sl->base && snapshot_get(sl->base, key, NULL);
+    if (in_base && !replace) {
+        epoch_exit(sl->epoch);
+        return false;
+    }
+    link_tower(sl, preds, ranks, top, key, value);
+    if (!in_base)
+        size_add(sl->size, 1);
+    wal_log(sl, replace ? WAL_PUT : WAL_INSERT, key, value);
+    epoch_exit(sl->epoch);
+    return !in_base;
+}
+
+void Insert(Skiplist* sl, int num) {
+    STAT_TIMER(start);
+    skiplist_insert(sl, num, NULL, false);
+    STAT_OP(STAT_INSERT, start);
+}
+
+// Returns true if the key is new, false if its value was replaced
+bool Put(Skiplist* sl, int64_t key, void* value) {
+    STAT_TIMER(start);
+    bool flag = skiplist_insert(sl, key, value, true);
+    STAT_OP(STAT_INSERT, start);
+    return flag;
+}
+
+// ======================================================================== //
+// ================= C O A R S E  L O C K  I N S E R T ==================== //
+// ======================================================================== //
+
+void CGL_Insert(Skiplist* sl, int num) {
+    // Lock the whole list
+    write_lock(sl->lock);
+    Insert(sl, num);
+    // Unlock the whole list
+    write_unlock(sl->lock);
+}
+
+bool CGL_Put(Skiplist* sl, int64_t key, void* value) {
+    write_lock(sl->lock);
+    bool flag = Put(sl, key, value);
+    write_unlock(sl->lock);
+    return flag;
+}
+
+// ======================================================================== //
+// =========== F I N E - G R A I N E D  L O C K  I N S E R T ============== //
+// ======================================================================== //
+
+// Lock the distinct predecessors on levels [0, top) bottom-up, i.e. in decreasing key
+// order like every other writer. Equal predecessors are adjacent.
+static void fgl_lock_preds(FGL_Node** preds, int top) {
+    for (int level = 0; level < top; level++) {
+        if (level == 0 || preds[level] != preds[level - 1])
+            lock_acquire(&preds[level]->lock);
+    }
+}
+
+static void fgl_unlock_preds(FGL_Node** preds, int top) {
+    for (int level = 0; level < top; level++) {
+        if (level == 0 || preds[level] != preds[level - 1])
+            omp_unset_lock(&preds[level]->lock);
+    }
+}
+
+// Leaves the predecessors of num in preds, so a batch can pass them on as the next finger
+static void fgl_insert(FGL_Skiplist* sl, int num, FGL_Node** preds, bool finger) {
+    FGL_Node* succs[MAX_LEVEL];
+    int randLevel = rand_level(sl->levels);
+
+    while (true) {
+        int found = fgl_find(sl, num, preds, succs, finger, randLevel);
+        if (found != -1) {
+            FGL_Node* node = succs[found];
+            if (!atomic_load(&node->marked)) {
+                // Already present: wait until its inserter is done so it can be searched
+                int spins = 0;
+                while (!atomic_load(&node->fully_linked))
+                    lock_backoff(&spins);
+                return;
+            }
+            // Being deleted: retry once it is unlinked
+            STAT_ADD(retries, 1);
+            continue;
+        }
+
+        // Nothing may have been deleted or linked in between since the traversal
+        fgl_lock_preds(preds, randLevel);
+        bool valid = true;
+        for (int level = 0; valid && level < randLevel; level++) {
+            valid = !atomic_load(&preds[level]->marked) &&
+                    (!succs[level] || !atomic_load(&succs[level]->marked)) &&
+                    atomic_load(&preds[level]->next[level]) == succs[level];
+        }
+        if (!valid) {
+            fgl_unlock_preds(preds, randLevel);
+            STAT_ADD(retries, 1);
+            finger = false;
+            continue;
+        }
+
+        FGL_Node* newNode = fgl_node_init(sl->alloc, num, randLevel);
+        for (int level = 0; level < randLevel; level++) {
+            atomic_init(&newNode->next[level], succs[level]);
+        }
+        for (int level = 0; level < randLevel; level++) {
+            atomic_store(&preds[level]->next[level], newNode);
+        }
+        atomic_store(&newNode->fully_linked, true);
+        fgl_unlock_preds(preds, randLevel);
+        size_add(sl->size, 1);
+        pivots_linked(sl->pivots, randLevel, fgl_pivots_rebuild, sl);
+        return;
+    }
+}
+
+void FGL_Insert(FGL_Skiplist* sl, int num) {
+    STAT_TIMER(start);
+    FGL_Node* preds[MAX_LEVEL];
+    epoch_enter(sl->epoch);
+    fgl_insert(sl, num, preds, false);
+    epoch_exit(sl->epoch);
+    STAT_OP(STAT_INSERT, start);
+}
+
+// ======================================================================== //
+// ================ L O C K - F R E E  I N S E R T ======================== //
+// ======================================================================== //
+
+// Find the predecessor and successor of num on every level, physically unlinking
+// the marked nodes on the way. Restarts if a CAS loses a race. height is the levels
+// whose preds the caller links or unlinks; the levels above the start are left alone.
+// Returns true if an unmarked node with val == num is on the bottom level.
+static bool lf_find(LF_Skiplist* sl, int num, LF_Node** preds, LF_Node** succs, int height) {
+retry:
+    {
+        int start;
+        LF_Node* pred = lf_start(sl, num, height, &start);
+        for (int level = start; level >= 0; level--) {
+            LF_Node* curr = LF_UNMARK(atomic_load(&pred->next[level]));
+            while (curr) {
+                uintptr_t succ = atomic_load(&curr->next[level]);
+                while (LF_MARKED(succ)) {
+                    // curr is deleted at this level: snip it out of pred
+                    uintptr_t expected = (uintptr_t)curr;
+                    if (!atomic_compare_exchange_strong(&pred->next[level], &expected, (uintptr_t)LF_UNMARK(succ))) {
+                        STAT_ADD(retries, 1);
+                        goto retry;
+                    }
+                    curr = LF_UNMARK(succ);
+                    if (!curr)
+                        break;
+                    succ = atomic_load(&curr->next[level]);
+                }
+                if (curr && curr->val < num) {
+                    STAT_VISIT(level);
+                    pred = curr;
+                    curr = LF_UNMARK(succ);
+                } else {
+                    break;
+                }
+            }
+            preds[level] = pred;
+            succs[level] = curr;
+        }
+        return succs[0] && succs[0]->val == num;
+    }
+}
+
+static bool lf_insert(LF_Skiplist* sl, int num) {
+    LF_Node* preds[MAX_LEVEL];
+    LF_Node* succs[MAX_LEVEL];
+    int randLevel = rand_level(sl->levels);
+    LF_Node* newNode = NULL;
+    epoch_enter(sl->epoch);
+
+    // Linking into the bottom level is the linearization point of the insertion
+    while (true) {
+        if (lf_find(sl, num, preds, succs, randLevel)) {
+            if (newNode)
+                node_free(sl->alloc, newNode, sizeof(LF_Node) + randLevel * sizeof(_Atomic uintptr_t));
+            epoch_exit(sl->epoch);
+            return false;
+        }
+        if (!newNode)
+            newNode = lf_node_init(sl->alloc, num, randLevel);
+        for (int level = 0; level < randLevel; level++) {
+            atomic_store(&newNode->next[level], (uintptr_t)succs[level]);
+        }
+        uintptr_t expected = (uintptr_t)succs[0];
+        if (atomic_compare_exchange_strong(&preds[0]->next[0], &expected, (uintptr_t)newNode))
+            break;
+        STAT_ADD(retries, 1);
+    }
+    size_add(sl->size, 1);
+
+    // Link the upper levels bottom-up; stop as soon as a deleter marks the node
+    for (int level = 1; level < randLevel; level++) {
+        while (true) {
+            uintptr_t next = atomic_load(&newNode->next[level]);
+            if (LF_MARKED(next))
+                goto done;
+            if (LF_UNMARK(next) != succs[level] &&
+                !atomic_compare_exchange_strong(&newNode->next[level], &next, (uintptr_t)succs[level]))
+                goto done;
+            uintptr_t expected = (uintptr_t)succs[level];
+            if (atomic_compare_exchange_strong(&preds[level]->next[level], &expected, (uintptr_t)newNode))
+                break;
+            STAT_ADD(retries, 1);
+            lf_find(sl, num, preds, succs, randLevel);
+        }
+    }
+done:
+    // A deleter may have marked the node after it got linked on some level; snip it again
+    if (LF_MARKED(atomic_load(&newNode->next[0])))
+        lf_find(sl, num, preds, succs, randLevel);
+    else
+        pivots_linked(sl->pivots, randLevel, lf_pivots_rebuild, sl);
+    lf_retire_vote(sl, newNode);
+    epoch_exit(sl->epoch);
+    return true;
+}
+
+// Returns false if num is already in the list
+bool LF_Insert(LF_Skiplist* sl, int num) {
+    STAT_TIMER(start);
+    bool flag = lf_insert(sl, num);
+    STAT_OP(STAT_INSERT, start);
+    return flag;
+}
+
+// ======================================================================== //
+// ============================= D E L E T E ============================== //
+// ======================================================================== //
+
+static bool skiplist_remove(Skiplist* sl, int64_t key, void** value) {
+    bool custom = sl->cmp || sl->key_width;
+    Node* preds[MAX_LEVEL];
+    epoch_enter(sl->epoch);
+    Node* temp = sl->head;
+    Node* node = NULL; // the tower to delete: the first one with an equal key on the highest level
+    int top = levels_in_use(sl->levels);
+    for (int level = top - 1; level >= 0; level--) {
+        // Below the top of the tower, walk right until its predecessor (duplicates may come first)
+        while (temp->next[level] && (node ? temp->next[level] != node : key_less(sl, custom, temp->next[level]->key, key))) {
+            STAT_VISIT(level);
+            temp = temp->next[level];
+        }
+        preds[level] = temp;
+        if (!node && temp->next[level] && key_equal(sl, custom, temp->next[level]->key, key)) {
+            node = temp->next[level];
+        }
+    }
+    if (node && node->value == TOMBSTONE) {
+        epoch_exit(sl->epoch);
+        return false;
+    }
+    if (node) {
+        if (value)
+            *value = node->value;
+        if (sl->base && snapshot_get(sl->base, key, NULL)) {
+            // The snapshot below still holds the key: keep the node as a tombstone hiding it
+            node->value = TOMBSTONE;
+        } else {
+            // connect the prev and next on every level to delete the tower
+            for (int level = 0; level < node->level; level++) {
+                preds[level]->next[level] = node->next[level];
+            }
+            if (sl->indexed) {
+                for (int level = 0; level < top; level++) {
+                    node_spans(preds[level])[level] += level < node->level ? node_spans(node)[level] - 1 : -1;
+                }
+            }
+            epoch_retire(sl->epoch, node); // freed once no concurrent search can still stand on it
+            levels_deleted(sl->levels, 1);
+        }
+        size_add(sl->size, -1);
+        wal_log(sl, WAL_DELETE, key, NULL);
+        epoch_exit(sl->epoch);
+        return true;
+    }
+    bool found = sl->base && snapshot_get(sl->base, key, value);
+    if (found) {
+        // Lists over a snapshot are never indexed, so the tombstone needs no ranks
+        link_tower(sl, preds, NULL, top, key, TOMBSTONE);
+        size_add(sl->size, -1);
+        wal_log(sl, WAL_DELETE, key, NULL);
+    }
+    epoch_exit(sl->epoch);
+    return found; // return false if failed to find thus can't delete
+}
+
+// The removed value is stored in *value unless it is NULL
+bool Remove(Skiplist* sl, int64_t key, void** value) {
+    STAT_TIMER(start);
+    bool flag = skiplist_remove(sl, key, value);
+    STAT_OP(STAT_DELETE, start);
+    return flag;
+}
+
+bool Delete(Skiplist* sl, int num) {
+    return Remove(sl, num, NULL);
+}
+
+// ======================================================================== //
+// ================= C O A R S E  L O C K  D E L E T E ==================== //
+// ======================================================================== //
+
+bool CGL_Delete(Skiplist* sl, int num) {
+    // Lock the whole list
+    write_lock(sl->lock);
+    bool flag = Delete(sl, num);
+    write_unlock(sl->lock);
+    return flag;
+}
+
+bool CGL_Remove(Skiplist* sl, int64_t key, void** value) {
+    write_lock(sl->lock);
+    bool flag = Remove(sl, key, value);
+    write_unlock(sl->lock);
+    return flag;
+}
+
+// ======================================================================== //
+// =========== F I N E - G R A I N E D  L O C K  D E L E T E ============== //
+// ======================================================================== //
+
+// Setting `marked` under the victim's lock is the linearization point; the victim
+// stays locked until it is unlinked so nobody can link a node after it.
+static bool fgl_delete(FGL_Skiplist* sl, int num, FGL_Node** preds, bool finger) {
+    FGL_Node* succs[MAX_LEVEL];
+    FGL_Node* victim = NULL;
+
+    while (true) {
+        int found = fgl_find(sl, num, preds, succs, finger, 0);
+        if (!victim) {
+            // Only a fully linked, unmarked node found on its top level can be deleted
+            if (found == -1 || !atomic_load(&succs[found]->fully_linked) ||
+                succs[found]->level - 1 != found || atomic_load(&succs[found]->marked)) {
+                return false;
+            }
+            victim = succs[found];
+            lock_acquire(&victim->lock);
+            if (atomic_load(&victim->marked)) {
+                omp_unset_lock(&victim->lock);
+                return false;
+            }
+            atomic_store(&victim->marked, true);
+        }
+
+        int top = victim->level;
+        fgl_lock_preds(preds, top);
+        bool valid = true;
+        for (int level = 0; valid && level < top; level++) {
+            valid = !atomic_load(&preds[level]->marked) && atomic_load(&preds[level]->next[level]) == victim;
+        }
+        if (!valid) {
+            fgl_unlock_preds(preds, top);
+            STAT_ADD(retries, 1);
+            finger = false;
+            continue;
+        }
+
+        for (int level = top - 1; level >= 0; level--) {
+            atomic_store(&preds[level]->next[level], atomic_load(&victim->next[level]));
+        }
+        omp_unset_lock(&victim->lock);
+        fgl_unlock_preds(preds, top);
+        if (pivots_unlinked(sl->pivots, victim, top, fgl_pivots_rebuild, sl))
+            epoch_retire(sl->epoch, victim);
+        size_add(sl->size, -1);
+        levels_deleted(sl->levels, 1);
+        return true;
+    }
+}
+
+bool FGL_Delete(FGL_Skiplist* sl, int num) {
+    STAT_TIMER(start);
+    FGL_Node* preds[MAX_LEVEL];
+    epoch_enter(sl->epoch);
+    bool flag = fgl_delete(sl, num, preds, false);
+    epoch_exit(sl->epoch);
+    STAT_OP(STAT_DELETE, start);
+    return flag;
+}
+
+// ======================================================================== //
+// ================ L O C K - F R E E  D E L E T E ======================== //
+// ======================================================================== //
+
+// Logically delete a node; false if another deleter got it first
+static bool lf_mark(LF_Node* node) {
+    // Mark the upper levels top-down so the node stops being reachable from above
+    for (int level = node->level - 1; level >= 1; level--) {
+        uintptr_t next = atomic_load(&node->next[level]);
+        while (!LF_MARKED(next)) {
+            if (!atomic_compare_exchange_weak(&node->next[level], &next, LF_MARK(next)))
+                STAT_ADD(retries, 1);
+        }
+    }
+
+    // Marking the bottom level is the linearization point; only one deleter wins it
+    uintptr_t next = atomic_load(&node->next[0]);
+    while (true) {
+        if (LF_MARKED(next))
+            return false;
+        if (atomic_compare_exchange_weak(&node->next[0], &next, LF_MARK(next)))
+            return true;
+        STAT_ADD(retries, 1);
+    }
+}
+
+static bool lf_delete(LF_Skiplist* sl, int num) {
+    LF_Node* preds[MAX_LEVEL];
+    LF_Node* succs[MAX_LEVEL];
+    epoch_enter(sl->epoch);
+    if (!lf_find(sl, num, preds, succs, 0) || !lf_mark(succs[0])) {
+        epoch_exit(sl->epoch);
+        return false;
+    }
+    LF_Node* node = succs[0];
+    size_add(sl->size, -1);
+    levels_deleted(sl->levels, 1);
+
+    // Physically unlink the node from every level
+    lf_find(sl, num, preds, succs, node->level);
+    if (pivots_unlinked(sl->pivots, node, node->level, lf_pivots_rebuild, sl))
+        lf_retire_vote(sl, node);
+    epoch_exit(sl->epoch);
+    return true;
+}
+
+bool LF_Delete(LF_Skiplist* sl, int num) {
+    STAT_TIMER(start);
+    bool flag = lf_delete(sl, num);
+    STAT_OP(STAT_DELETE, start);
+    return flag;
+}
+
+// ======================================================================== //
+// ============================== B A T C H =============================== //
+// ======================================================================== //
+
+// A batch is sorted once and then walked with a finger: the predecessors of the previous
+// key, from which the next key is found in O(log distance) instead of O(log n) from the head.
+
+// Bottom-up merge sort so custom comparators can see the list
+static void sort_keys(const Skiplist* sl, bool custom, int64_t* keys, size_t n) {
+    int64_t* tmp = (int64_t*)malloc(n * sizeof(int64_t));
+    int64_t* src = keys;
+    int64_t* dst = tmp;
+    for (size_t width = 1; width < n; width *= 2) {
+        for (size_t lo = 0; lo < n; lo += 2 * width) {
+            size_t mid = lo + width < n ? lo + width : n;
+            size_t hi = lo + 2 * width < n ? lo + 2 * width : n;
+            size_t i = lo, j = mid, k = lo;
+            while (i < mid && j < hi) {
+                dst[k++] = key_less(sl, custom, src[j], src[i]) ? src[j++] : src[i++];
+            }
+            while (i < mid) dst[k++] = src[i++];
+            while (j < hi) dst[k++] = src[j++];
+        }
+        int64_t* swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != keys)
+        memcpy(keys, src, n * sizeof(int64_t));
+    free(tmp);
+}
+
+// Returns keys itself if the batch is already sorted, otherwise a sorted copy to free
+static int64_t* sorted_batch(const Skiplist* sl, bool custom, const int64_t* keys, size_t n) {
+    size_t i = 1;
+    while (i < n && !key_less(sl, custom, keys[i], keys[i - 1])) {
+        i++;
+    }
+    if (i >= n)
+        return (int64_t*)keys;
+    int64_t* copy = (int64_t*)malloc(n * sizeof(int64_t));
+    memcpy(copy, keys, n * sizeof(int64_t));
+    sort_keys(sl, custom, copy, n);
+    return copy;
+}
+
+// Move the finger from its previous key to key (not smaller): climb while the next node
+// on the level is still before key, then descend from there like a search.
+static void finger_seek(Skiplist* sl, bool custom, Node** preds, int64_t key) {
+    int level = 0, top = levels_in_use(sl->levels) - 1;
+    while (level < top && preds[level]->next[level] && key_less(sl, custom, preds[level]->next[level]->key, key)) {
+        level++;
+    }
+    Node* temp = preds[level];
+    for (; level >= 0; level--) {
+        while (temp->next[level] && key_less(sl, custom, temp->next[level]->key, key)) {
+            STAT_VISIT(level);
+            temp = temp->next[level];
+        }
+        preds[level] = temp;
+    }
+}
+
+static void insert_sorted(Skiplist* sl, bool custom, const int64_t* keys, size_t n) {
+    Node* preds[MAX_LEVEL];
+    if (sl->base || sl->indexed) {
+        // The finger only walks the overlay; each key must also be checked against the snapshot.
+        // It does not keep ranks either, which the spans of an indexed list need.
+        for (size_t i = 0; i < n; i++) {
+            skiplist_insert(sl, keys[i], NULL, false);
+        }
+        return;
+    }
+    for (int level = 0; level < MAX_LEVEL; level++) {
+        preds[level] = sl->head;
+    }
+    epoch_enter(sl->epoch);
+    for (size_t i = 0; i < n; i++) {
+        finger_seek(sl, custom, preds, keys[i]);
+        int randLevel = rand_level(sl->levels);
+        Node* newNode = node_init(sl, keys[i], NULL, randLevel);
+        for (int level = 0; level < randLevel; level++) {
+            newNode->next[level] = preds[level]->next[level];
+            preds[level]->next[level] = newNode;
+            preds[level] = newNode;
+        }
+        wal_log(sl, WAL_INSERT, keys[i], NULL);
+    }
+    size_add(sl->size, n);
+    epoch_exit(sl->epoch);
+}
+
+static long delete_sorted(Skiplist* sl, bool custom, const int64_t* keys, size_t n) {
+    Node* preds[MAX_LEVEL];
+    long deleted = 0;
+    if (sl->base || sl->indexed) {
+        for (size_t i = 0; i < n; i++) {
+            deleted += Remove(sl, keys[i], NULL);
+        }
+        return deleted;
+    }
+    for (int level = 0; level < MAX_LEVEL; level++) {
+        preds[level] = sl->head;
+    }
+    epoch_enter(sl->epoch);
+    for (size_t i = 0; i < n; i++) {
+        finger_seek(sl, custom, preds, keys[i]);
+        // The first equal node on the bottom level is also first on every level of its tower
+        Node* node = preds[0]->next[0];
+        if (!node || !key_equal(sl, custom, node->key, keys[i]))
+            continue;
+        for (int level = 0; level < node->level; level++) {
+            preds[level]->next[level] = node->next[level];
+        }
+        epoch_retire(sl->epoch, node);
+        wal_log(sl, WAL_DELETE, keys[i], NULL);
+        deleted++;
+    }
+    size_add(sl->size, -deleted);
+    levels_deleted(sl->levels, deleted);
+    epoch_exit(sl->epoch);
+    return deleted;
+}
+
+// Insert every key with a NULL value, like Insert
+void InsertBatch(Skiplist* sl, const int64_t* keys, size_t n) {
+    bool custom = sl->cmp || sl->key_width;
+    int64_t* sorted = sorted_batch(sl, custom, keys, n);
+    insert_sorted(sl, custom, sorted, n);
+    if (sorted != keys)
+        free(sorted);
+}
+
+// Returns the number of keys deleted
+long DeleteBatch(Skiplist* sl, const int64_t* keys, size_t n) {
+    bool custom = sl->cmp || sl->key_width;
+    int64_t* sorted = sorted_batch(sl, custom, keys, n);
+    long deleted = delete_sorted(sl, custom, sorted, n);
+    if (sorted != keys)
+        free(sorted);
+    return deleted;
+}
+
+// The batch is sorted before the write lock is taken, and the lock is taken once per batch
+void CGL_InsertBatch(Skiplist* sl, const int64_t* keys, size_t n) {
+    bool custom = sl->cmp || sl->key_width;
+    int64_t* sorted = sorted_batch(sl, custom, keys, n);
+    write_lock(sl->lock);
+    insert_sorted(sl, custom, sorted, n);
+    write_unlock(sl->lock);
+    if (sorted != keys)
+        free(sorted);
+}
+
+long CGL_DeleteBatch(Skiplist* sl, const int64_t* keys, size_t n) {
+    bool custom = sl->cmp || sl->key_width;
+    int64_t* sorted = sorted_batch(sl, custom, keys, n);
+    write_lock(sl->lock);
+    long deleted = delete_sorted(sl, custom, sorted, n);
+    write_unlock(sl->lock);
+    if (sorted != keys)
+        free(sorted);
+    return deleted;
+}
+
+static int int_compare(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+// Returns nums itself if the batch is already sorted, otherwise a sorted copy to free
+static int* sorted_ints(const int* nums, size_t n) {
+    size_t i = 1;
+    while (i < n && nums[i] >= nums[i - 1]) {
+        i++;
+    }
+    if (i >= n)
+        return (int*)nums;
+    int* copy = (int*)malloc(n * sizeof(int));
+    memcpy(copy, nums, n * sizeof(int));
+    qsort(copy, n, sizeof(int), int_compare);
+    return copy;
+}
+
+#define BATCH_RUN 64            // keys linked or unlinked together under one set of locks
+#define FINGER_STEPS 32         // LF deletes: farthest a key is walked to from the previous one
+
+// Link the keys at the start of sorted that fall in the gap before the first one's successor:
+// the gap's predecessors are locked and validated once and the new towers are chained
+// privately, then spliced in on each level. Returns how many keys were used up.
+static size_t fgl_insert_run(FGL_Skiplist* sl, const int* sorted, size_t n, FGL_Node** preds) {
+    FGL_Node* succs[MAX_LEVEL];
+    FGL_Node* run[BATCH_RUN];
+    int heights[BATCH_RUN];
+    int drawn = 0;
+
+    while (true) {
+        int top = levels_in_use(sl->levels);
+        int found = fgl_find(sl, sorted[0], preds, succs, true, 0);
+        if (found != -1) {
+            FGL_Node* node = succs[found];
+            if (atomic_load(&node->marked)) {
+                STAT_ADD(retries, 1);
+                continue;
+            }
+            // Already present: wait until its inserter is done so it can be searched
+            int spins = 0;
+            while (!atomic_load(&node->fully_linked))
+                lock_backoff(&spins);
+            size_t used = 1;
+            while (used < n && sorted[used] == sorted[0]) {
+                used++;
+            }
+            return used;
+        }
+
+        // Every following key below the successor joins the run, duplicates once
+        int count = 0, height = 0;
+        size_t used = 0;
+        for (; used < n && (!succs[0] || sorted[used] < succs[0]->val); used++) {
+            if (used > 0 && sorted[used] == sorted[used - 1])
+                continue;
+            if (count == BATCH_RUN)
+                break;
+            if (count == drawn) {
+                int level = rand_level(sl->levels);
+                heights[drawn++] = level < top ? level : top;
+            }
+            if (heights[count] > height)
+                height = heights[count];
+            count++;
+        }
+
+        fgl_lock_preds(preds, height);
+        bool valid = true;
+        for (int level = 0; valid && level < height; level++) {
+            valid = !atomic_load(&preds[level]->marked) &&
+                    (!succs[level] || !atomic_load(&succs[level]->marked)) &&
+                    atomic_load(&preds[level]->next[level]) == succs[level];
+        }
+        if (!valid) {
+            fgl_unlock_preds(preds, height);
+            STAT_ADD(retries, 1);
+            continue;
+        }
+
+        for (int i = 0, key = 0; i < count; i++, key++) {
+            while (key > 0 && sorted[key] == sorted[key - 1]) {
+                key++;
+            }
+            run[i] = fgl_node_init(sl->alloc, sorted[key], heights[i]);
+        }
+        // Chain the towers of every level back to front, then splice each level in
+        for (int level = 0; level < height; level++) {
+            FGL_Node* next = succs[level];
+            for (int i = count - 1; i >= 0; i--) {
+                if (heights[i] > level) {
+                    atomic_init(&run[i]->next[level], next);
+                    next = run[i];
+                }
+            }
+            atomic_store(&preds[level]->next[level], next);
+        }
+        for (int i = 0; i < count; i++) {
+            atomic_store(&run[i]->fully_linked, true);
+        }
+        fgl_unlock_preds(preds, height);
+        size_add(sl->size, count);
+        pivots_linked(sl->pivots, height, fgl_pivots_rebuild, sl);
+        // The last new tower of each level is the finger of the next run
+        for (int i = 0; i < count; i++) {
+            for (int level = 0; level < heights[i]; level++) {
+                preds[level] = run[i];
+            }
+        }
+        return used;
+    }
+}
+
+// Delete the keys at the start of sorted that are held by consecutive nodes: the nodes are
+// locked once and the predecessors of the first one once, and every level is unlinked in
+// one store. Returns how many keys were used up and adds the nodes deleted to *deleted.
+static size_t fgl_delete_run(FGL_Skiplist* sl, const int* sorted, size_t n, FGL_Node** preds, long* deleted) {
+    FGL_Node* succs[MAX_LEVEL];
+    FGL_Node* run[BATCH_RUN];
+    size_t used = 1;
+    while (used < n && sorted[used] == sorted[0]) {
+        used++;
+    }
+
+    // Only a fully linked, unmarked node found on its top level can be deleted
+    int found = fgl_find(sl, sorted[0], preds, succs, true, 0);
+    if (found == -1 || !atomic_load(&succs[found]->fully_linked) ||
+        succs[found]->level - 1 != found || atomic_load(&succs[found]->marked))
+        return used;
+    int count = 1;
+    run[0] = succs[0];
+    for (FGL_Node* node = atomic_load(&run[0]->next[0]); node && used < n && count < BATCH_RUN && sorted[used] == node->val;
+         node = atomic_load(&node->next[0])) {
+        if (!atomic_load(&node->fully_linked) || atomic_load(&node->marked))
+            break;
+        run[count++] = node;
+        while (used < n && sorted[used] == node->val) {
+            used++;
+        }
+    }
+
+    // Lock back to front, like a single delete locks its node before its predecessors. Keep
+    // the nodes up to the first one another deleter marked or that is no longer next in line.
+    for (int i = count - 1; i >= 0; i--) {
+        lock_acquire(&run[i]->lock);
+    }
+    int kept = 0;
+    while (kept < count && !atomic_load(&run[kept]->marked) &&
+           (kept == 0 || atomic_load(&run[kept - 1]->next[0]) == run[kept])) {
+        kept++;
+    }
+    for (int i = kept; i < count; i++) {
+        omp_unset_lock(&run[i]->lock);
+    }
+    if (kept < count) {
+        // The keys of the nodes let go are tried again
+        int last = kept > 0 ? run[kept - 1]->val : sorted[0];
+        used = 0;
+        while (used < n && sorted[used] <= last) {
+            used++;
+        }
+        if (kept == 0)
+            return used;
+    }
+    count = kept;
+    int height = 0;
+    for (int i = 0; i < count; i++) {
+        atomic_store(&run[i]->marked, true);
+        if (run[i]->level > height)
+            height = run[i]->level;
+    }
+
+    while (true) {
+        fgl_lock_preds(preds, height);
+        bool valid = true;
+        for (int level = 0, i = 0; valid && level < height; level++) {
+            while (run[i]->level <= level) {
+                i++;
+            }
+            valid = !atomic_load(&preds[level]->marked) && atomic_load(&preds[level]->next[level]) == run[i];
+        }
+        if (valid)
+            break;
+        fgl_unlock_preds(preds, height);
+        STAT_ADD(retries, 1);
+        fgl_find(sl, run[0]->val, preds, succs, true, 0);
+    }
+
+    for (int level = height - 1; level >= 0; level--) {
+        int last = count - 1;
+        while (run[last]->level <= level) {
+            last--;
+        }
+        atomic_store(&preds[level]->next[level], atomic_load(&run[last]->next[level]));
+    }
+    for (int i = 0; i < count; i++) {
+        omp_unset_lock(&run[i]->lock);
+    }
+    fgl_unlock_preds(preds, height);
+    for (int i = 0; i < count; i++) {
+        if (pivots_unlinked(sl->pivots, run[i], run[i]->level, fgl_pivots_rebuild, sl))
+            epoch_retire(sl->epoch, run[i]);
+    }
+    size_add(sl->size, -count);
+    levels_deleted(sl->levels, count);
+    *deleted += count;
+    return used;
+}
+
+// Keys falling in one gap between two nodes are linked under one lock of the gap's
+// predecessors, up to BATCH_RUN of them; the traversal to the next gap starts from the finger
+void FGL_InsertBatch(FGL_Skiplist* sl, const int* nums, size_t n) {
+    FGL_Node* preds[MAX_LEVEL];
+    int* sorted = sorted_ints(nums, n);
+    for (int level = 0; level < MAX_LEVEL; level++) {
+        preds[level] = sl->head;
+    }
+    epoch_enter(sl->epoch);
+    for (size_t i = 0; i < n;) {
+        i += fgl_insert_run(sl, sorted + i, n - i, preds);
+    }
+    epoch_exit(sl->epoch);
+    if (sorted != nums)
+        free(sorted);
+}
+
+// Keys held by consecutive nodes are deleted under one lock of each node and of their
+// predecessors, up to BATCH_RUN of them
+long FGL_DeleteBatch(FGL_Skiplist* sl, const int* nums, size_t n) {
+    FGL_Node* preds[MAX_LEVEL];
+    long deleted = 0;
+    int* sorted = sorted_ints(nums, n);
+    for (int level = 0; level < MAX_LEVEL; level++) {
+        preds[level] = sl->head;
+    }
+    epoch_enter(sl->epoch);
+    for (size_t i = 0; i < n;) {
+        i += fgl_delete_run(sl, sorted + i, n - i, preds, &deleted);
+    }
+    epoch_exit(sl->epoch);
+    if (sorted != nums)
+        free(sorted);
+    return deleted;
+}
+
+// Like lf_find for lo, but every level goes on up to hi and snips the marked nodes there too
+static void lf_unlink_range(LF_Skiplist* sl, int lo, int hi, int height) {
+retry:
+    {
+        int start;
+        LF_Node* pred = lf_start(sl, lo, height, &start);
+        for (int level = start; level >= 0; level--) {
+            LF_Node* node = pred;   // pred stays the last node below lo: the next level starts there
+            LF_Node* curr = LF_UNMARK(atomic_load(&node->next[level]));
+            while (curr && curr->val <= hi) {
+                uintptr_t succ = atomic_load(&curr->next[level]);
+                if (LF_MARKED(succ)) {
+                    uintptr_t expected = (uintptr_t)curr;
+                    if (!atomic_compare_exchange_strong(&node->next[level], &expected, (uintptr_t)LF_UNMARK(succ))) {
+                        STAT_ADD(retries, 1);
+                        goto retry;
+                    }
+                    curr = LF_UNMARK(succ);
+                    continue;
+                }
+                if (curr->val < lo) {
+                    STAT_VISIT(level);
+                    pred = curr;
+                }
+                node = curr;
+                curr = LF_UNMARK(succ);
+            }
+        }
+    }
+}
+
+// Link the keys at the start of sorted that fall in the gap before the first one's successor:
+// the new nodes are chained privately and one CAS links them all into the bottom level,
+// then each upper level is linked from the last node linked there. Returns how many keys
+// were used up and adds the keys inserted to *inserted.
+static size_t lf_insert_run(LF_Skiplist* sl, const int* sorted, size_t n, long* inserted) {
+    LF_Node* preds[MAX_LEVEL];
+    LF_Node* succs[MAX_LEVEL];
+    LF_Node* run[BATCH_RUN];
+    int heights[BATCH_RUN];
+    int drawn = 0, count = 0;
+    size_t used = 0;
+
+    while (true) {
+        int top = levels_in_use(sl->levels);
+        if (lf_find(sl, sorted[0], preds, succs, MAX_LEVEL)) {
+            // Inserted by another thread since a pass that lost its CAS
+            used = 0;
+            while (used < n && sorted[used] == sorted[0]) {
+                used++;
+            }
+            return used;
+        }
+        count = 0;
+        for (used = 0; used < n && (!succs[0] || sorted[used] < succs[0]->val); used++) {
+            if (used > 0 && sorted[used] == sorted[used - 1])
+                continue;
+            if (count == BATCH_RUN)
+                break;
+            if (count == drawn) {
+                int level = rand_level(sl->levels);
+                heights[drawn++] = level < top ? level : top;
+            }
+            run[count] = lf_node_init(sl->alloc, sorted[used], heights[count]);
+            count++;
+        }
+        for (int i = 0; i < count; i++) {
+            atomic_store(&run[i]->next[0], (uintptr_t)(i + 1 < count ? run[i + 1] : succs[0]));
+            for (int level = 1; level < heights[i]; level++) {
+                atomic_store(&run[i]->next[level], (uintptr_t)succs[level]);
+            }
+        }
+        uintptr_t expected = (uintptr_t)succs[0];
+        if (atomic_compare_exchange_strong(&preds[0]->next[0], &expected, (uintptr_t)run[0]))
+            break;
+        STAT_ADD(retries, 1);
+        for (int i = 0; i < count; i++) {
+            node_free(sl->alloc, run[i], sizeof(LF_Node) + heights[i] * sizeof(_Atomic uintptr_t));
+        }
+    }
+    size_add(sl->size, count);
+    *inserted += count;
+
+    // Link the upper levels node by node, as lf_insert does; stop a node once a deleter marks it
+    for (int i = 0; i < count; i++) {
+        LF_Node* node = run[i];
+        for (int level = 1; level < heights[i]; level++) {
+            while (true) {
+                uintptr_t next = atomic_load(&node->next[level]);
+                if (LF_MARKED(next))
+                    goto next_node;
+                if (succs[level] && succs[level]->val <= node->val) {
+                    // A node was linked in front of this one since: find the gap again
+                    lf_find(sl, node->val, preds, succs, MAX_LEVEL);
+                    continue;
+                }
+                if (LF_UNMARK(next) != succs[level] &&
+                    !atomic_compare_exchange_strong(&node->next[level], &next, (uintptr_t)succs[level]))
+                    goto next_node;
+                uintptr_t expected = (uintptr_t)succs[level];
+                if (atomic_compare_exchange_strong(&preds[level]->next[level], &expected, (uintptr_t)node))
+                    break;
+                STAT_ADD(retries, 1);
+                lf_find(sl, node->val, preds, succs, MAX_LEVEL);
+            }
+            preds[level] = node;
+        }
+    next_node:;
+    }
+
+    // A deleter may have marked a node after it got linked on some level; snip it again
+    int height = 0;
+    for (int i = 0; i < count; i++) {
+        if (LF_MARKED(atomic_load(&run[i]->next[0])))
+            lf_find(sl, run[i]->val, preds, succs, heights[i]);
+        else if (heights[i] > height)
+            height = heights[i];
+    }
+    if (height > 0)
+        pivots_linked(sl->pivots, height, lf_pivots_rebuild, sl);
+    for (int i = 0; i < count; i++) {
+        lf_retire_vote(sl, run[i]);
+    }
+    return used;
+}
+
+// Delete the keys at the start of sorted that lie close together: the first one is located
+// from the pivots, each next one by walking at most FINGER_STEPS bottom level nodes from the
+// last, and a single pass unlinks all the marked nodes. Returns how many keys were used up
+// and adds the nodes deleted to *deleted.
+static size_t lf_delete_run(LF_Skiplist* sl, const int* sorted, size_t n, long* deleted) {
+    LF_Node* run[BATCH_RUN];
+    LF_Node* finger = NULL;
+    int count = 0;
+    size_t used = 0;
+
+    while (used < n && count < BATCH_RUN) {
+        int num = sorted[used];
+        LF_Node* curr;
+        if (used == 0) {
+            curr = lf_locate(sl, num);
+        } else {
+            // The next key is too far away, or the finger was deleted: start a new region.
+            // Keys are distinct, so a key close to the finger's is few nodes away.
+            if (!finger || (long)num - finger->val > FINGER_STEPS || LF_MARKED(atomic_load(&finger->next[0])))
+                break;
+            // The finger may already be the key: it was the first node not below the last one
+            curr = finger;
+            int steps = 0;
+            while (curr && steps < FINGER_STEPS && (curr->val < num || LF_MARKED(atomic_load(&curr->next[0])))) {
+                STAT_VISIT(0);
+                curr = LF_UNMARK(atomic_load(&curr->next[0]));
+                steps++;
+            }
+            if (steps == FINGER_STEPS)
+                break;
+        }
+        while (used < n && sorted[used] == num) {
+            used++;
+        }
+        if (curr && curr->val == num)
+            run[count++] = curr;
+        finger = curr;
+    }
+
+    int kept = 0, height = 0;
+    for (int i = 0; i < count; i++) {
+        if (lf_mark(run[i])) {
+            run[kept++] = run[i];
+            if (run[i]->level > height)
+                height = run[i]->level;
+        }
+    }
+    if (kept == 0)
+        return used;
+    size_add(sl->size, -kept);
+    levels_deleted(sl->levels, kept);
+    *deleted += kept;
+    lf_unlink_range(sl, run[0]->val, run[kept - 1]->val, height);
+    for (int i = 0; i < kept; i++) {
+        if (pivots_unlinked(sl->pivots, run[i], run[i]->level, lf_pivots_rebuild, sl))
+            lf_retire_vote(sl, run[i]);
+    }
+    return used;
+}
+
+// Keys falling in one gap between two nodes are linked with one CAS on the bottom level,
+// up to BATCH_RUN of them. Returns the number of keys inserted.
+long LF_InsertBatch(LF_Skiplist* sl, const int* nums, size_t n) {
+    long inserted = 0;
+    int* sorted = sorted_ints(nums, n);
+    epoch_enter(sl->epoch);
+    for (size_t i = 0; i < n;) {
+        i += lf_insert_run(sl, sorted + i, n - i, &inserted);
+    }
+    epoch_exit(sl->epoch);
+    if (sorted != nums)
+        free(sorted);
+    return inserted;
+}
+
+// Keys close together are unlinked by one pass over their stretch of the list,
+// up to BATCH_RUN of them. Returns the number of keys deleted.
+long LF_DeleteBatch(LF_Skiplist* sl, const int* nums, size_t n) {
+    long deleted = 0;
+    int* sorted = sorted_ints(nums, n);
+    epoch_enter(sl->epoch);
+    for (size_t i = 0; i < n;) {
+        i += lf_delete_run(sl, sorted + i, n - i, &deleted);
+    }
+    epoch_exit(sl->epoch);
+    if (sorted != nums)
+        free(sorted);
+    return deleted;
+}
+
+// ======================================================================== //
+// ========================== B U L K   L O A D =========================== //
+// ======================================================================== //
+
+// Build a list from keys that are already sorted, without searching: node i reaches
+// level 1 + ctz(i + 1), i.e. every 2^k-th node is promoted k times. Each OpenMP thread
+// allocates and links one slice of the array in key order; the slices are then
+// stitched together level by level.
+
+static int build_level(size_t i, int max_level) {
+    int level = 1 + __builtin_ctzll(i + 1);
+    return level < max_level ? level : max_level;
+}
+
+// Account for n towers built at once, the tallest of them `level` high
+static void levels_built(Level_Gen* gen, size_t n, int level) {
+    levels_count(gen, n);
+    levels_raise(gen, level);
+}
+
+// The towers built by one thread, first and last node on every level and, for the
+// spans of an indexed list, their positions in the slice counted from 1
+typedef struct Build_Slice {
+    Node* first[MAX_LEVEL];
+    Node* last[MAX_LEVEL];
+    size_t first_at[MAX_LEVEL];
+    size_t last_at[MAX_LEVEL];
+    size_t count;
+} Build_Slice;
+
+static void slice_append(Skiplist* sl, Build_Slice* slice, int64_t key, void* value) {
+    int level = build_level(slice->count++, sl->levels->max_level);
+    Node* node = node_init(sl, key, value, level);
+    for (int l = 0; l < level; l++) {
+        if (slice->last[l]) {
+            slice->last[l]->next[l] = node;
+            if (sl->indexed)
+                node_spans(slice->last[l])[l] = slice->count - slice->last_at[l];
+        } else {
+            slice->first[l] = node;
+            slice->first_at[l] = slice->count;
+        }
+        slice->last[l] = node;
+        slice->last_at[l] = slice->count;
+    }
+}
+
+// Link the slices in order behind the head, which must be empty
+static void slices_stitch(Skiplist* sl, Build_Slice* slices, int count) {
+    size_t towers = 0;
+    int top = 1;
+    for (int l = 0; l < sl->levels->max_level; l++) {
+        Node* tail = sl->head;
+        size_t tail_at = 0, offset = 0;
+        for (int t = 0; t < count; t++) {
+            if (slices[t].first[l]) {
+                tail->next[l] = slices[t].first[l];
+                if (sl->indexed)
+                    node_spans(tail)[l] = offset + slices[t].first_at[l] - tail_at;
+                tail = slices[t].last[l];
+                tail_at = offset + slices[t].last_at[l];
+                top = l + 1;
+            }
+            offset += slices[t].count;
+        }
+    }
+    for (int t = 0; t < count; t++) {
+        towers += slices[t].count;
+    }
+    levels_built(sl->levels, towers, top);
+    size_add(sl->size, towers);
+}
+
+// Fill an empty list from sorted keys; values may be NULL
+static void build_into(Skiplist* sl, const int64_t* keys, void* const* values, size_t n) {
+    int threads = omp_get_max_threads();
+    Build_Slice* slices = calloc(threads, sizeof(Build_Slice));
+
+    #pragma omp parallel num_threads(threads)
+    {
+        int t = omp_get_thread_num(), count = omp_get_num_threads();
+        for (size_t i = n * t / count; i < n * (t + 1) / count; i++) {
+            slice_append(sl, &slices[t], keys[i], values ? values[i] : NULL);
+        }
+    }
+
+    slices_stitch(sl, slices, threads);
+    free(slices);
+}
+
+// values may be NULL; duplicate keys are kept like with Insert
+Skiplist* skiplist_build_sorted_with(const Skiplist_Config* config, const int64_t* keys, void* const* values, size_t n) {
+    Skiplist* sl = skiplist_init_with(config);
+    build_into(sl, keys, values, n);
+    return sl;
+}
+
+Skiplist* skiplist_build_sorted(const int64_t* keys, size_t n) {
+    return skiplist_build_sorted_with(NULL, keys, NULL, n);
+}
+
+// nums must be strictly increasing
+// Load sorted, distinct nums into an empty list
+static void fgl_build_into(FGL_Skiplist* sl, const int* nums, size_t n) {
+    int threads = omp_get_max_threads();
+    FGL_Node* (*first)[MAX_LEVEL] = calloc(threads, sizeof(*first));
+    FGL_Node* (*last)[MAX_LEVEL] = calloc(threads, sizeof(*last));
+
+    #pragma omp parallel num_threads(threads)
+    {
+        int t = omp_get_thread_num(), count = omp_get_num_threads();
+        for (size_t i = n * t / count; i < n * (t + 1) / count; i++) {
+            int level = build_level(i, sl->levels->max_level);
+            FGL_Node* node = fgl_node_init(sl->alloc, nums[i], level);
+            atomic_init(&node->fully_linked, true);
+            for (int l = 0; l < level; l++) {
+                if (last[t][l])
+                    atomic_init(&last[t][l]->next[l], node);
+                else
+                    first[t][l] = node;
+                last[t][l] = node;
+            }
+        }
+    }
+
+    int top = 1;
+    for (int l = 0; l < sl->levels->max_level; l++) {
+        FGL_Node* tail = sl->head;
+        for (int t = 0; t < threads; t++) {
+            if (first[t][l]) {
+                atomic_store(&tail->next[l], first[t][l]);
+                tail = last[t][l];
+                top = l + 1;
+            }
+        }
+    }
+    levels_built(sl->levels, n, top);
+    size_add(sl->size, n);
+    pivots_built(sl->pivots, sl->epoch, fgl_pivots_rebuild, sl);
+    free(first);
+    free(last);
+}
+
+FGL_Skiplist* fgl_skiplist_build_sorted_with(const Skiplist_Config* config, const int* nums, size_t n) {
+    FGL_Skiplist* sl = fgl_skiplist_init_with(config);
+    fgl_build_into(sl, nums, n);
+    return sl;
+}
+
+FGL_Skiplist* fgl_skiplist_build_sorted(const int* nums, size_t n) {
+    return fgl_skiplist_build_sorted_with(NULL, nums, n);
+}
+
+// nums must be strictly increasing
+LF_Skiplist* lf_skiplist_build_sorted_with(const Skiplist_Config* config, const int* nums, size_t n) {
+    LF_Skiplist* sl = lf_skiplist_init_with(config);
+    int threads = omp_get_max_threads();
+    LF_Node* (*first)[MAX_LEVEL] = calloc(threads, sizeof(*first));
+    LF_Node* (*last)[MAX_LEVEL] = calloc(threads, sizeof(*last));
+
+    #pragma omp parallel num_threads(threads)
+    {
+        int t = omp_get_thread_num(), count = omp_get_num_threads();
+        for (size_t i = n * t / count; i < n * (t + 1) / count; i++) {
+            int level = build_level(i, sl->levels->max_level);
+            LF_Node* node = lf_node_init(sl->alloc, nums[i], level);
+            atomic_init(&node->votes, 1);   // the inserter's vote: it is done with the node
+            for (int l = 0; l < level; l++) {
+                if (last[t][l])
+                    atomic_init(&last[t][l]->next[l], (uintptr_t)node);
+                else
+                    first[t][l] = node;
+                last[t][l] = node;
+            }
+        }
+    }
+
+    int top = 1;
+    for (int l = 0; l < sl->levels->max_level; l++) {
+        LF_Node* tail = sl->head;
+        for (int t = 0; t < threads; t++) {
+            if (first[t][l]) {
+                atomic_store(&tail->next[l], (uintptr_t)first[t][l]);
+                tail = last[t][l];
+                top = l + 1;
+            }
+        }
+    }
+    levels_built(sl->levels, n, top);
+    size_add(sl->size, n);
+    pivots_built(sl->pivots, sl->epoch, lf_pivots_rebuild, sl);
+    free(first);
+    free(last);
+    return sl;
+}
+
+LF_Skiplist* lf_skiplist_build_sorted(const int* nums, size_t n) {
+    return lf_skiplist_build_sorted_with(NULL, nums, n);
+}
+
+// ======================================================================== //
+// ===================== S E T   O P E R A T I O N S ====================== //
+// ======================================================================== //
+
+// Walk the bottom levels of both lists in order and build the towers of the result
+// like skiplist_build_sorted. The key space is split into ranges of about equal size
+// in a, and each OpenMP thread merges one range. Both lists must order keys the same way.
+
+typedef enum Set_Op {
+    SET_UNION,
+    SET_INTERSECTION,
+    SET_DIFFERENCE
+} Set_Op;
+
+// Position a cursor on the first key of the list
+static void cursor_first(Cursor* cur, Skiplist* sl) {
+    cur->sl = sl;
+    cur->locked = false;
+    epoch_enter(sl->epoch);
+    cur->node = sl->head->next[0];
+    cur->base = 0;
+}
+
+// Pick up to ranges - 1 split keys from the highest level of sl that has enough nodes.
+// Returns the number of ranges.
+static int split_keys(Skiplist* sl, int ranges, int64_t* split) {
+    if (sl->base && sl->base->count >= (size_t)ranges) {
+        for (int r = 1; r < ranges; r++) {
+            split[r] = sl->base->level_keys[0][sl->base->count * r / ranges];
+        }
+        return ranges;
+    }
+    for (int level = levels_in_use(sl->levels) - 1; level >= 0; level--) {
+        long count = 0;
+        for (Node* temp = sl->head->next[level]; temp; temp = temp->next[level]) {
+            count++;
+        }
+        if (count < ranges && level > 0)
+            continue;
+        if (count < ranges)
+            ranges = count ? (int)count : 1;
+        long i = 0;
+        int r = 1;
+        for (Node* temp = sl->head->next[level]; temp && r < ranges; temp = temp->next[level], i++) {
+            if (i == count * r / ranges)
+                split[r++] = temp->key;
+        }
+        return ranges;
+    }
+    return 1;
+}
+
+// Next key of a cursor while it is below the end of its range
+static bool next_in_range(Cursor* cur, bool custom, bool last, int64_t hi, int64_t* key, void** value) {
+    return Next(cur, key, value) && (last || key_less(cur->sl, custom, *key, hi));
+}
+
+// Equal keys take b's value in a union and a's value in an intersection
+static void set_build(Skiplist* out, Skiplist* a, Skiplist* b, Set_Op op, Build_Slice* slices, int ranges, const int64_t* split) {
+    bool custom = a->cmp || a->key_width;
+
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(ranges)
+    for (int t = 0; t < ranges; t++)
+    {
+        Cursor ca, cb;
+        int64_t ka, kb;
+        void* va;
+        void* vb;
+        if (t == 0) {
+            cursor_first(&ca, a);
+            cursor_first(&cb, b);
+        } else {
+            Seek(&ca, a, split[t]);
+            Seek(&cb, b, split[t]);
+        }
+        bool last = t == ranges - 1;
+        int64_t hi = last ? 0 : split[t + 1];
+        bool in_a = next_in_range(&ca, custom, last, hi, &ka, &va);
+        bool in_b = next_in_range(&cb, custom, last, hi, &kb, &vb);
+        while (in_a || in_b) {
+            if (in_a && (!in_b || key_less(a, custom, ka, kb))) {
+                if (op != SET_INTERSECTION)
+                    slice_append(out, &slices[t], ka, va);
+                in_a = next_in_range(&ca, custom, last, hi, &ka, &va);
+            } else if (in_b && (!in_a || key_less(a, custom, kb, ka))) {
+                if (op == SET_UNION)
+                    slice_append(out, &slices[t], kb, vb);
+                in_b = next_in_range(&cb, custom, last, hi, &kb, &vb);
+            } else {
+                if (op == SET_UNION)
+                    slice_append(out, &slices[t], kb, vb);
+                else if (op == SET_INTERSECTION)
+                    slice_append(out, &slices[t], ka, va);
+                in_a = next_in_range(&ca, custom, last, hi, &ka, &va);
+                in_b = next_in_range(&cb, custom, last, hi, &kb, &vb);
+            }
+        }
+        Cursor_Close(&cb);
+        Cursor_Close(&ca);
+    }
+}
+
+// The result gets a's allocator, keys and lock, and the default p and seed
+static Skiplist* set_operation(Skiplist* a, Skiplist* b, Set_Op op) {
+    Skiplist_Config config = {
+        .alloc = a->alloc->type,
+        .cmp = a->cmp,
+        .key_width = a->key_width,
+        .lock = a->lock->type,
+        .indexed = a->indexed,
+    };
+    Skiplist* out = skiplist_init_with(&config);
+    int threads = omp_get_max_threads();
+    int64_t* split = malloc((threads + 1) * sizeof(int64_t));
+    int ranges = split_keys(a, threads, split);
+    Build_Slice* slices = calloc(ranges, sizeof(Build_Slice));
+    set_build(out, a, b, op, slices, ranges, split);
+    slices_stitch(out, slices, ranges);
+    free(slices);
+    free(split);
+    return out;
+}
+
+Skiplist* skiplist_union(Skiplist* a, Skiplist* b) {
+    return set_operation(a, b, SET_UNION);
+}
+
+Skiplist* skiplist_intersection(Skiplist* a, Skiplist* b) {
+    return set_operation(a, b, SET_INTERSECTION);
+}
+
+Skiplist* skiplist_difference(Skiplist* a, Skiplist* b) {
+    return set_operation(a, b, SET_DIFFERENCE);
+}
+
+// Put every key of src into dst: the union is built from dst's allocator, then replaces
+// dst's towers (and snapshot), which are retired like deleted nodes. src is left as it was.
+void skiplist_merge(Skiplist* dst, Skiplist* src) {
+    int threads = omp_get_max_threads();
+    int64_t* split = malloc((threads + 1) * sizeof(int64_t));
+    int ranges = split_keys(dst->head->next[0] ? dst : src, threads, split);
+    Build_Slice* slices = calloc(ranges, sizeof(Build_Slice));
+    set_build(dst, dst, src, SET_UNION, slices, ranges, split);
+
+    epoch_enter(dst->epoch);
+    Node* temp = dst->head->next[0];
+    for (int level = 0; level < dst->head->level; level++) {
+        dst->head->next[level] = NULL;
+    }
+    long towers = 0;
+    while (temp) {
+        Node* del = temp;
+        temp = temp->next[0];
+        epoch_retire(dst->epoch, del);
+        towers++;
+    }
+    levels_deleted(dst->levels, towers);
+    epoch_exit(dst->epoch);
+    size_add(dst->size, -size_sum(dst->size));
+    slices_stitch(dst, slices, ranges);
+    // The log sees the merge as a Put of every key of src
+    if (dst->wal) {
+        Cursor cur;
+        int64_t key;
+        void* value;
+        cursor_first(&cur, src);
+        while (Next(&cur, &key, &value)) {
+            wal_log(dst, WAL_PUT, key, value);
+        }
+        Cursor_Close(&cur);
+    }
+    // The union holds the snapshot keys too, so the list no longer needs it
+    if (dst->base) {
+        snapshot_unmap(dst->base);
+        dst->base = NULL;
+    }
+    free(slices);
+    free(split);
+}
+
+// ======================================================================== //
+// ========================= R A N G E   S C A N ========================== //
+// ======================================================================== //
+
+// A cursor stays inside an epoch critical section from Seek to Cursor_Close, so the
+// node it stands on cannot be freed under it. Deleted towers keep their forward
+// pointers, so a cursor on one still reaches every later key.
+//
+// Consistency: CGL_Seek/CGL_RangeScan hold the read side of the list's lock for the
+// whole scan and see a snapshot; the thread must not write to the list before
+// closing. All other cursors are weakly consistent: keys come out in order, each at
+// most once, every key present for the whole scan is reported, and keys inserted or
+// deleted during the scan may or may not be.
+
+void Seek(Cursor* cur, Skiplist* sl, int64_t key) {
+    bool custom = sl->cmp || sl->key_width;
+    cur->sl = sl;
+    cur->locked = false;
+    epoch_enter(sl->epoch);
+    Node* temp = sl->head;
+    for (int level = levels_in_use(sl->levels) - 1; level >= 0; level--) {
+        while (temp->next[level] && key_less(sl, custom, temp->next[level]->key, key)) {
+            STAT_VISIT(level);
+            temp = temp->next[level];
+        }
+    }
+    cur->node = temp->next[0];
+    cur->base = sl->base ? snapshot_lower_bound(sl->base, key) : 0;
+}
+
+void CGL_Seek(Cursor* cur, Skiplist* sl, int64_t key) {
+    read_lock(sl->lock);
+    Seek(cur, sl, key);
+    cur->locked = true;
+}
+
+// Over a snapshot, merges the overlay with the snapshot keys; overlay nodes win
+bool Next(Cursor* cur, int64_t* key, void** value) {
+    const Snapshot* base = cur->sl->base;
+    while (true) {
+        Node* node = cur->node;
+        if (base && cur->base < base->count && (!node || base->level_keys[0][cur->base] < node->key)) {
+            if (key)
+                *key = base->level_keys[0][cur->base];
+            if (value)
+                *value = (void*)(uintptr_t)base->values[cur->base];
+            cur->base++;
+            return true;
+        }
+        if (!node)
+            return false;
+        if (base && cur->base < base->count && base->level_keys[0][cur->base] == node->key)
+            cur->base++;
+        cur->node = node->next[0];
+        if (node->value == TOMBSTONE)
+            continue;
+        if (key)
+            *key = node->key;
+        if (value)
+            *value = node->value;
+        return true;
+    }
+}
+
+void Cursor_Close(Cursor* cur) {
+    epoch_exit(cur->sl->epoch);
+    if (cur->locked)
+        read_unlock(cur->sl->lock);
+}
+
+// Report every key in [lo, hi) in order until fn returns false; returns the number of keys reported
+static long range_scan(Cursor* cur, int64_t hi, Scan_Fn fn, void* arg) {
+    bool custom = cur->sl->cmp || cur->sl->key_width;
+    long count = 0;
+    int64_t key;
+    void* value;
+    while (Next(cur, &key, &value) && key_less(cur->sl, custom, key, hi)) {
+        count++;
+        if (!fn(key, value, arg))
+            break;
+    }
+    Cursor_Close(cur);
+    return count;
+}
+
+long RangeScan(Skiplist* sl, int64_t lo, int64_t hi, Scan_Fn fn, void* arg) {
+    STAT_TIMER(start);
+    Cursor cur;
+    Seek(&cur, sl, lo);
+    long count = range_scan(&cur, hi, fn, arg);
+    STAT_OP(STAT_SCAN, start);
+    return count;
+}
+
+long CGL_RangeScan(Skiplist* sl, int64_t lo, int64_t hi, Scan_Fn fn, void* arg) {
+    STAT_TIMER(start);
+    Cursor cur;
+    CGL_Seek(&cur, sl, lo);
+    long count = range_scan(&cur, hi, fn, arg);
+    STAT_OP(STAT_SCAN, start);
+    return count;
+}
+
+void FGL_Seek(FGL_Cursor* cur, FGL_Skiplist* sl, int num) {
+    cur->sl = sl;
+    epoch_enter(sl->epoch);
+    FGL_Node* preds[MAX_LEVEL];
+    FGL_Node* succs[MAX_LEVEL];
+    fgl_find(sl, num, preds, succs, false, 0);
+    cur->node = succs[0];
+}
+
+bool FGL_Next(FGL_Cursor* cur, int* num) {
+    FGL_Node* node = cur->node;
+    // Step over the nodes that are logically deleted
+    while (node && atomic_load(&node->marked)) {
+        node = atomic_load(&node->next[0]);
+    }
+    if (!node)
+        return false;
+    *num = node->val;
+    cur->node = atomic_load(&node->next[0]);
+    return true;
+}
+
+void FGL_Cursor_Close(FGL_Cursor* cur) {
+    epoch_exit(cur->sl->epoch);
+}
+
+long FGL_RangeScan(FGL_Skiplist* sl, int lo, int hi, Scan_Fn fn, void* arg) {
+    STAT_TIMER(start);
+    FGL_Cursor cur;
+    long count = 0;
+    int num;
+    FGL_Seek(&cur, sl, lo);
+    while (FGL_Next(&cur, &num) && num < hi) {
+        count++;
+        if (!fn(num, NULL, arg))
+            break;
+    }
+    FGL_Cursor_Close(&cur);
+    STAT_OP(STAT_SCAN, start);
+    return count;
+}
+
+// Step from node to the first node at or after it that is not logically deleted
+static LF_Node* lf_skip_marked(LF_Node* node) {
+    while (node) {
+        uintptr_t next = atomic_load(&node->next[0]);
+        if (!LF_MARKED(next))
+            break;
+        node = LF_UNMARK(next);
+    }
+    return node;
+}
+
+void LF_Seek(LF_Cursor* cur, LF_Skiplist* sl, int num) {
+    cur->sl = sl;
+    epoch_enter(sl->epoch);
+    cur->node = lf_locate(sl, num);
+}
+
+bool LF_Next(LF_Cursor* cur, int* num) {
+    LF_Node* node = cur->node;
+    if (!node)
+        return false;
+    *num = node->val;
+    cur->node = lf_skip_marked(LF_UNMARK(atomic_load(&node->next[0])));
+    return true;
+}
+
+void LF_Cursor_Close(LF_Cursor* cur) {
+    epoch_exit(cur->sl->epoch);
+}
+
+long LF_RangeScan(LF_Skiplist* sl, int lo, int hi, Scan_Fn fn, void* arg) {
+    STAT_TIMER(start);
+    LF_Cursor cur;
+    long count = 0;
+    int num;
+    LF_Seek(&cur, sl, lo);
+    while (LF_Next(&cur, &num) && num < hi) {
+        count++;
+        if (!fn(num, NULL, arg))
+            break;
+    }
+    LF_Cursor_Close(&cur);
+    STAT_OP(STAT_SCAN, start);
+    return count;
+}
+
+// ======================================================================== //
+// ==================== S I Z E ,  R A N K ,  S E L E C T ================= //
+// ======================================================================== //
+
+// Sizes are summed from the per-thread counters, so they cost O(MAX_THREADS) and never
+// walk the list. They are exact once writers are done and only approximate while they run.
+long Size(Skiplist* sl) {
+    return size_sum(sl->size);
+}
+
+long FGL_Size(FGL_Skiplist* sl) {
+    return size_sum(sl->size);
+}
+
+long LF_Size(LF_Skiplist* sl) {
+    return size_sum(sl->size);
+}
+
+// Number of keys smaller than key, counting duplicates; -1 unless the list is indexed.
+// The descent of a search adds up the spans of the links it takes.
+long Rank(Skiplist* sl, int64_t key) {
+    if (!sl->indexed)
+        return -1;
+    bool custom = sl->cmp || sl->key_width;
+    long rank = 0;
+    epoch_enter(sl->epoch);
+    Node* temp = sl->head;
+    for (int level = levels_in_use(sl->levels) - 1; level >= 0; level--) {
+        while (temp->next[level] && key_less(sl, custom, temp->next[level]->key, key)) {
+            STAT_VISIT(level);
+            rank += node_spans(temp)[level];
+            temp = temp->next[level];
+        }
+    }
+    epoch_exit(sl->epoch);
+    return rank;
+}
+
+// Find the key of rank k, the (k + 1)-th smallest, and its value; either may be NULL.
+// Returns false if k is out of range or the list is not indexed.
+bool Select(Skiplist* sl, long k, int64_t* key, void** value) {
+    if (!sl->indexed || k < 0)
+        return false;
+    long rank = 0;
+    epoch_enter(sl->epoch);
+    Node* temp = sl->head;
+    for (int level = levels_in_use(sl->levels) - 1; level >= 0 && rank <= k; level--) {
+        while (temp->next[level] && rank + node_spans(temp)[level] <= k + 1) {
+            STAT_VISIT(level);
+            rank += node_spans(temp)[level];
+            temp = temp->next[level];
+        }
+    }
+    bool found = rank == k + 1;
+    if (found && key)
+        *key = temp->key;
+    if (found && value)
+        *value = temp->value;
+    epoch_exit(sl->epoch);
+    return found;
+}
+
+long CGL_Rank(Skiplist* sl, int64_t key) {
+    read_lock(sl->lock);
+    long rank = Rank(sl, key);
+    read_unlock(sl->lock);
+    return rank;
+}
+
+bool CGL_Select(Skiplist* sl, long k, int64_t* key, void** value) {
+    read_lock(sl->lock);
+    bool found = Select(sl, k, key, value);
+    read_unlock(sl->lock);
+    return found;
+}
+
+// ======================================================================== //
+// ============================ P R O F I L E ============================= //
+// ======================================================================== //
+
+// A sampled profile walks the level seg = ceil(log(1/sample) / log(1/p)) from the head,
+// which sees every tower taller than seg, and walks the bottom level only in every
+// (1/sample)-th segment between two of those towers. Everything above seg is exact; the
+// towers up to seg high are scaled from the segments walked to the size of the list (or,
+// over a snapshot, whose keys have no towers, to the number of segments). About 2 * sample
+// of the list is read. Towers are walked inside the list's epoch, like a scan.
+
+// Promotion probability of the towers a generator draws
+static double level_p(const Level_Gen* gen) {
+    return gen->shift ? 1.0 / (1 << gen->shift) : gen->threshold / 18446744073709551616.0;
+}
+
+// Heap taken by one node allocation: its slab block, or its glibc malloc chunk
+static size_t heap_block(const Node_Allocator* alloc, size_t size) {
+    if (alloc->type == ALLOC_MALLOC)
+        return size + 8 <= 32 ? 32 : (size + 8 + 15) / 16 * 16;
+    int cls = size_class(size);
+    return cls < SLAB_CLASSES ? (size_t)16 << cls : CACHE_LINE + size;
+}
+
+typedef struct Profile_Walk {
+    long since[MAX_LEVEL];      // towers exactly l high passed since the last one on level l
+    long gap_sum[MAX_LEVEL];
+    long gap_count[MAX_LEVEL];
+    long max_gap[MAX_LEVEL];
+} Profile_Walk;
+
+// A tower `height` high is passed: close the gaps it ends on the levels [lo, hi)
+static void profile_step(Profile_Walk* walk, int height, int lo, int hi) {
+    for (int level = lo; level < hi; level++) {
+        if (height > level) {
+            long gap = walk->since[level] + 1;
+            walk->gap_sum[level] += gap;
+            walk->gap_count[level]++;
+            if (gap > walk->max_gap[level])
+                walk->max_gap[level] = gap;
+            walk->since[level] = 0;
+        } else if (height == level) {
+            walk->since[level]++;
+        }
+    }
+}
+
+// Profile the towers and memory of a list, walking about 2 * sample of it (sample <= 0 or >= 1 walks all).
+// Over a snapshot only the towers of the overlay are profiled.
+void skiplist_profile(Skiplist* sl, double sample, Skiplist_Profile* profile) {
+    memset(profile, 0, sizeof(Skiplist_Profile));
+    Level_Gen* gen = sl->levels;
+    double p = level_p(gen);
+    int top = levels_in_use(gen);
+    int seg = 0;
+    long stride = 1;
+    if (sample > 0 && sample < 1) {
+        // Towers taller than seg are one in (1/p)^seg
+        for (double skip = 1; seg < top - 1 && skip < 1 / sample; skip /= p) {
+            seg++;
+        }
+        stride = (long)(1 / sample + 0.5);
+    } else {
+        sample = 1;
+    }
+    profile->sample = sample;
+    profile->p = p;
+    profile->levels = top;
+
+    // Towers taller than seg are counted exactly, the ones up to seg high in the sampled segments
+    long tall[MAX_LEVEL] = { 0 };
+    long inner[MAX_LEVEL] = { 0 };
+    long segments = 0, sampled = 0;
+    Profile_Walk walk;
+    memset(&walk, 0, sizeof(Profile_Walk));
+    epoch_enter(sl->epoch);
+    for (Node* bound = sl->head; bound; bound = bound->next[seg]) {
+        if (bound != sl->head) {
+            int height = bound->level < top ? bound->level : top;
+            tall[height - 1]++;
+            profile_step(&walk, height, seg + 1, top);
+        }
+        if (seg > 0 && segments++ % stride == 0) {
+            // The bottom level up to the next tower taller than seg, which closes every gap up to seg
+            sampled++;
+            for (int level = 1; level <= seg; level++) {
+                walk.since[level] = 0;
+            }
+            Node* node = bound->next[0];
+            for (; node && node->level <= seg; node = node->next[0]) {
+                inner[node->level - 1]++;
+                profile_step(&walk, node->level, 1, seg + 1);
+            }
+            if (node)
+                profile_step(&walk, node->level, 1, seg + 1);
+        }
+    }
+    epoch_exit(sl->epoch);
+
+    long tall_total = 0, inner_total = 0;
+    for (int h = 0; h < top; h++) {
+        tall_total += tall[h];
+        inner_total += inner[h];
+    }
+    double scale = sampled ? (double)segments / sampled : 0;
+    if (!sl->base && inner_total)
+        scale = (double)(size_sum(sl->size) - tall_total) / inner_total;
+    for (int h = 0; h < top; h++) {
+        profile->heights[h] = tall[h] + (long)(inner[h] * scale + 0.5);
+        profile->nodes += profile->heights[h];
+    }
+    size_t link = sizeof(Node*) + (sl->indexed ? sizeof(long) : 0);
+    for (int h = top - 1; h >= 0; h--) {
+        Level_Profile* level = &profile->level[h];
+        level->nodes = profile->heights[h] + (h + 1 < top ? profile->level[h + 1].nodes : 0);
+        level->bytes = level->nodes * (link + (h == 0 ? offsetof(Node, next) : 0));
+        level->mean_gap = walk.gap_count[h] ? (double)walk.gap_sum[h] / walk.gap_count[h] : 0;
+        level->max_gap = walk.max_gap[h];
+        profile->node_bytes += profile->heights[h] * heap_block(sl->alloc, node_size(sl, h + 1));
+    }
+    double reach = 1;   // share of the towers at least h + 1 high
+    for (int h = 0; h < top; h++, reach *= p) {
+        profile->ideal[h] = profile->nodes * reach * (h + 1 < top ? 1 - p : 1);
+    }
+
+    profile->sentinel_bytes = heap_block(sl->alloc, node_size(sl, sl->head->level));
+    profile->list_bytes = sizeof(Skiplist) + sizeof(Node_Allocator) + sizeof(Epoch_Domain) +
+                          sizeof(Level_Gen) + sizeof(Coarse_Lock) + sizeof(Size_Counter);
+    if (sl->alloc->type == ALLOC_SLAB)
+        profile->heap_bytes = allocator_sys_allocs(sl->alloc) * SLAB_SIZE + profile->list_bytes;
+    else
+        profile->heap_bytes = profile->node_bytes + profile->sentinel_bytes + profile->list_bytes;
+}
+
+void skiplist_profile_print(const Skiplist_Profile* profile) {
+    printf("%ld towers on %d levels, p = %g, %.1f%% walked\n", profile->nodes, profile->levels, profile->p, profile->sample * 100);
+    printf("Level |      nodes | mean gap | max gap |        bytes\n");
+    for (int h = profile->levels - 1; h >= 0; h--) {
+        const Level_Profile* level = &profile->level[h];
+        if (h == 0 || level->mean_gap == 0)
+            printf("%5d | %10ld |        - |       - | %12zu\n", h + 1, level->nodes, level->bytes);
+        else
+            printf("%5d | %10ld | %8.2f | %7ld | %12zu\n", h + 1, level->nodes, level->mean_gap, level->max_gap, level->bytes);
+    }
+    printf("Height |     towers |        ideal\n");
+    for (int h = 0; h < profile->levels; h++) {
+        printf("%6d | %10ld | %12.1f\n", h + 1, profile->heights[h], profile->ideal[h]);
+    }
+    printf("Heap: %zu bytes (towers %zu, sentinel %zu, list %zu)\n",
+           profile->heap_bytes, profile->node_bytes, profile->sentinel_bytes, profile->list_bytes);
 }
 
-// Initiation for fine-grained lock node: 
-FGL_Node* fgl_node_init(int val) {
-    FGL_Node* newNode = (FGL_Node*)malloc(sizeof(FGL_Node));
-    newNode->val = val;
-    newNode->right = NULL;
-    newNode->down = NULL;
-    return newNode;
+// ======================================================================== //
+// ======================= C H U N K E D   L I S T ======================== //
+// ======================================================================== //
+
+// An unrolled skip list: each tower carries up to CHUNK_KEYS sorted keys in one cache line,
+// so the bottom level costs one miss per chunk instead of one per key. The upper levels
+// route by a chunk's first key; the head holds the smallest keys and is the only chunk
+// that may be empty. A full chunk splits in two, and one that falls under a quarter full
+// merges with its successor or borrows keys from it.
+
+#define CHUNK_MIN (CHUNK_KEYS / 4)
+
+static size_t chunk_size(int level) {
+    return sizeof(Chunk_Node) + level * sizeof(Chunk_Node*);
 }
 
-// Initiation for fine-grained lock skip list: 
-FGL_Skiplist* fgl_skiplist_init() {
-    FGL_Skiplist* sl = (FGL_Skiplist*)malloc(sizeof(FGL_Skiplist));
-    sl->head = fgl_node_init(-MAX_INT);
+static Chunk_Node* chunk_node_init(Node_Allocator* alloc, int level) {
+    Chunk_Node* node = (Chunk_Node*)node_alloc(alloc, chunk_size(level));
+    for (int i = 0; i < CHUNK_KEYS; i++) {
+        node->keys[i] = MAX_INT;
+    }
+    node->count = 0;
+    node->level = level;
+    for (int i = 0; i < level; i++) {
+        node->next[i] = NULL;
+    }
+    return node;
+}
+
+Chunk_Skiplist* chunk_skiplist_init_with(const Skiplist_Config* config) {
+    Chunk_Skiplist* sl = (Chunk_Skiplist*)malloc(sizeof(Chunk_Skiplist));
+    sl->alloc = allocator_init(config);
+    sl->levels = level_gen_init(config);
+    sl->head = chunk_node_init(sl->alloc, sl->levels->max_level);
     return sl;
 }
 
-// ======================================================================== //
-// ============================= S E A R C H ============================== //
-// ======================================================================== //
+Chunk_Skiplist* chunk_skiplist_init() {
+    return chunk_skiplist_init_with(NULL);
+}
 
-// Search is read-only so it can be used in parallel without synchronizaton
-bool Search(Skiplist* sl, int num) {
-    Node* temp = sl->head;
-    while (temp) {
-        while (temp->right && temp->right->val < num) {
-            temp = temp->right;
-        }
-        if (temp->right && temp->right->val == num) {
-            return true;
+// Number of keys in the chunk less than num; the MAX_INT padding is never less
+static inline int chunk_rank(const Chunk_Node* node, int num) {
+    return rank32(node->keys, CHUNK_KEYS, num);
+}
+
+// The last chunk on every level whose first key is at most num (or, with `strict`, less
+// than num); preds[0] is the chunk num belongs in. Above the levels in use, preds is the
+// head, so a split may draw a tower taller than the levels searched.
+static Chunk_Node* chunk_find(Chunk_Skiplist* sl, int num, Chunk_Node** preds, bool strict) {
+    Chunk_Node* temp = sl->head;
+    int top = levels_in_use(sl->levels);
+    for (int level = top - 1; level >= 0; level--) {
+        while (temp->next[level] && (strict ? temp->next[level]->keys[0] < num : temp->next[level]->keys[0] <= num)) {
+            STAT_VISIT(level);
+            temp = temp->next[level];
         }
-        temp = temp->down;
+        if (preds)
+            preds[level] = temp;
     }
-    return false;
+    for (int level = top; preds && level < sl->levels->max_level; level++) {
+        preds[level] = sl->head;
+    }
+    return temp;
 }
 
-// ======================================================================== //
-// ========= F I N E - G R A I N E D  L O C K  S E A R C H ================ //
-// ======================================================================== //
+bool Chunk_Search(Chunk_Skiplist* sl, int num) {
+    STAT_TIMER(start);
+    Chunk_Node* chunk = chunk_find(sl, num, NULL, false);
+    int rank = chunk_rank(chunk, num);
+    bool found = rank < chunk->count && chunk->keys[rank] == num;
+    STAT_OP(STAT_SEARCH, start);
+    return found;
+}
 
-// Search is read-only so it can be used in parallel without synchronizaton
-// This is modified only for the FGL_Skiplist input argument
-bool FGL_Search(FGL_Skiplist* sl, int num) {
-    FGL_Node* temp = sl->head;
-    while (temp) {
-        while (temp->right && temp->right->val < num) {
-            temp = temp->right;
-        }
-        if (temp->right && temp->right->val == num) {
-            return true;
-            break;
+// Move the upper half of a full chunk into a new tower linked right behind it
+static Chunk_Node* chunk_split(Chunk_Skiplist* sl, Chunk_Node** preds, Chunk_Node* chunk) {
+    Chunk_Node* right = chunk_node_init(sl->alloc, rand_level(sl->levels));
+    int half = CHUNK_KEYS / 2;
+    for (int i = half; i < CHUNK_KEYS; i++) {
+        right->keys[i - half] = chunk->keys[i];
+        chunk->keys[i] = MAX_INT;
+    }
+    right->count = CHUNK_KEYS - half;
+    chunk->count = half;
+    // Every pred is at or before chunk, and its successor is past chunk
+    for (int level = 0; level < right->level; level++) {
+        Chunk_Node* pred = level < chunk->level ? chunk : preds[level];
+        right->next[level] = pred->next[level];
+        pred->next[level] = right;
+    }
+    return right;
+}
+
+static bool chunk_insert(Chunk_Skiplist* sl, int num) {
+    Chunk_Node* preds[MAX_LEVEL];
+    if (num == MAX_INT)
+        return false;
+    Chunk_Node* chunk = chunk_find(sl, num, preds, false);
+    int rank = chunk_rank(chunk, num);
+    if (rank < chunk->count && chunk->keys[rank] == num)
+        return false;
+    if (chunk->count == CHUNK_KEYS) {
+        Chunk_Node* right = chunk_split(sl, preds, chunk);
+        if (rank > chunk->count) {
+            rank -= chunk->count;
+            chunk = right;
         }
-        temp = temp->down;
     }
-    return false;
+    memmove(&chunk->keys[rank + 1], &chunk->keys[rank], (chunk->count - rank) * sizeof(int));
+    chunk->keys[rank] = num;
+    chunk->count++;
+    return true;
 }
 
-// ======================================================================== //
-// ============================= I N S E R T ============================== //
-// ======================================================================== //
+// Returns false if num is already in the list
+bool Chunk_Insert(Chunk_Skiplist* sl, int num) {
+    STAT_TIMER(start);
+    bool flag = chunk_insert(sl, num);
+    STAT_OP(STAT_INSERT, start);
+    return flag;
+}
 
-// Create an int representing the random level of the new inserted node by flipping a coin
-int rand_level() {
-    int level = 1;
-    while (rand() % 2 && level < MAX_LEVEL) {
-        level++;
+// Unlink a chunk from every level of its tower
+static void chunk_unlink(Chunk_Skiplist* sl, Chunk_Node* chunk) {
+    Chunk_Node* preds[MAX_LEVEL];
+    chunk_find(sl, chunk->keys[0], preds, true);
+    for (int level = 0; level < chunk->level; level++) {
+        preds[level]->next[level] = chunk->next[level];
     }
-    return level;
+    node_free(sl->alloc, chunk, chunk_size(chunk->level));
+    levels_deleted(sl->levels, 1);
 }
 
-void Insert(Skiplist* sl, int num) {
-    Node* temp = sl->head;
-    Node* newNode = node_init(num);
-    int currentLevel = MAX_LEVEL;
-    int randLevel = rand_level();
-    while (currentLevel > 0 && temp){
-        // Find the correct position by moving right
-        while (temp->right && temp->right->val < num) {
-            temp = temp->right;
-        }
-        // Add the node if reached the level
-        if (randLevel >= currentLevel) {
-            newNode->right = temp->right;
-            temp->right = newNode;
-            if (currentLevel == 1) {
-                newNode->down = NULL;
-            }
-            else {
-                // Add a new level
-                if (!temp->down) {
-                    Node* newHead = node_init(-MAX_INT);
-                    temp->down = newHead;
-                }
-                newNode->down = node_init(num);
-            }
-            // Move down
-            newNode = newNode->down;
-        } else {
-            if (!temp->down) {
-                Node* newHead = node_init(-MAX_INT);
-                temp->down = newHead;
-            }
-        }
-        temp = temp->down;
-        currentLevel--;
+// Refill a chunk under CHUNK_MIN keys from its successor: take all of them if they fit,
+// otherwise enough to leave both chunks even
+static void chunk_rebalance(Chunk_Skiplist* sl, Chunk_Node* chunk) {
+    Chunk_Node* right = chunk->next[0];
+    if (!right)
+        return;
+    int take = chunk->count + right->count <= CHUNK_KEYS ? right->count : (right->count - chunk->count) / 2;
+    memcpy(&chunk->keys[chunk->count], right->keys, take * sizeof(int));
+    chunk->count += take;
+    if (take == right->count) {
+        chunk_unlink(sl, right);
+        return;
+    }
+    // right's first key grows, which keeps it between chunk's keys and its successor's
+    memmove(right->keys, &right->keys[take], (right->count - take) * sizeof(int));
+    for (int i = right->count - take; i < right->count; i++) {
+        right->keys[i] = MAX_INT;
     }
+    right->count -= take;
 }
 
-// ======================================================================== //
-// ================= C O A R S E  L O C K  I N S E R T ==================== //
-// ======================================================================== //
+static bool chunk_delete(Chunk_Skiplist* sl, int num) {
+    Chunk_Node* chunk = chunk_find(sl, num, NULL, false);
+    int rank = chunk_rank(chunk, num);
+    if (rank == chunk->count || chunk->keys[rank] != num)
+        return false;
+    if (chunk->count == 1 && chunk != sl->head) {
+        chunk_unlink(sl, chunk);
+        return true;
+    }
+    memmove(&chunk->keys[rank], &chunk->keys[rank + 1], (chunk->count - rank - 1) * sizeof(int));
+    chunk->keys[--chunk->count] = MAX_INT;
+    if (chunk->count < CHUNK_MIN)
+        chunk_rebalance(sl, chunk);
+    return true;
+}
 
-void CGL_Insert(Skiplist* sl, int num) {
-    // Lock the whole list
-    omp_set_lock(&coarse_grained_lock);
-    Node* temp = sl->head;
-    Node* newNode = node_init(num);
-    int currentLevel = MAX_LEVEL;
-    int randLevel = rand_level();
-    while (currentLevel > 0 && temp){
-        // Find the correct position by moving right
-        while (temp->right && temp->right->val < num) {
-            temp = temp->right;
-        }
-        // Add the node if reached the level
-        if (randLevel >= currentLevel) {
-            newNode->right = temp->right;
-            temp->right = newNode;
-            if(currentLevel==1){
-                newNode->down = NULL;
-            }
-            else {
-                // Add a new level
-                if (!temp->down){
-                    Node* newHead = node_init(-MAX_INT);
-                    temp->down = newHead;
-                }
-                newNode->down = node_init(num);
-            }
-            newNode = newNode->down;
-        }
-        else {
-            if (!temp->down){
-                Node* newHead = node_init(-MAX_INT);
-                temp->down = newHead;
-            }
+bool Chunk_Delete(Chunk_Skiplist* sl, int num) {
+    STAT_TIMER(start);
+    bool flag = chunk_delete(sl, num);
+    STAT_OP(STAT_DELETE, start);
+    return flag;
+}
+
+static long chunk_range_scan(Chunk_Skiplist* sl, int lo, int hi, Scan_Fn fn, void* arg) {
+    Chunk_Node* chunk = chunk_find(sl, lo, NULL, false);
+    long count = 0;
+    for (int i = chunk_rank(chunk, lo); chunk; chunk = chunk->next[0], i = 0) {
+        for (; i < chunk->count; i++) {
+            if (chunk->keys[i] >= hi)
+                return count;
+            count++;
+            if (!fn(chunk->keys[i], NULL, arg))
+                return count;
         }
-        temp = temp->down;
-        currentLevel--;
     }
-    // Unlock the whole list
-    omp_unset_lock(&coarse_grained_lock);
+    return count;
+}
+
+long Chunk_RangeScan(Chunk_Skiplist* sl, int lo, int hi, Scan_Fn fn, void* arg) {
+    STAT_TIMER(start);
+    long count = chunk_range_scan(sl, lo, hi, fn, arg);
+    STAT_OP(STAT_SCAN, start);
+    return count;
 }
 
 // ======================================================================== //
-// =========== F I N E - G R A I N E D  L O C K  I N S E R T ============== //
+// ======================== S H A R D E D   L I S T ======================= //
 // ======================================================================== //
 
-void FGL_Insert(FGL_Skiplist* sl, int num) {
+// Every shard is an FGL list of its own, so threads working on different key ranges never
+// share a head, a lock or a cache line. The shards are spread over the NUMA nodes in ascending
+// blocks, and their nodes come from slabs bound to their node, so a thread that works on the
+// keys of its own node (Shard_Local) stays in local memory. Point operations touch one shard;
+// range scans walk the shards in key order.
 
-    FGL_Node* temp = sl->head;
-    FGL_Node* newNode = fgl_node_init(num);
-    int currentLevel = MAX_LEVEL;
-    int randLevel = rand_level();
-
-    // Lock the head node before traversal
-    omp_set_lock(&temp->lock);
-
-    while (currentLevel > 0 && temp){
-        // Lock the current node before traversal
-        omp_set_lock(&temp->lock);
-
-        while (temp->right && temp->right->val < num) {
-            // Unlock the previous node
-            omp_unset_lock(&temp->lock);
-            temp = temp->right;
-            // Lock the new current node
-            omp_set_lock(&temp->lock);
-        }
-        if (randLevel >= currentLevel) {
-            newNode->right = temp->right;
-            temp->right = newNode;
-
-            // Unlock the current node after modification
-            omp_unset_lock(&temp->lock);
-
-            if (currentLevel==1){
-                newNode->down = NULL;
-            }
-            else {
-                if (!temp->down){
-                    FGL_Node* newHead = fgl_node_init(-MAX_INT);
-                    temp->down = newHead;
-                }
-                newNode->down = fgl_node_init(num);
-            }
-            newNode = newNode->down;
-            }
-        else {
-            if (!temp->down){
-                FGL_Node* newHead = fgl_node_init(-MAX_INT);
-                temp->down = newHead;
-            }
+// NUMA nodes of the machine, as listed in sysfs; 1 if it lists none
+static int numa_nodes_present(void) {
+    char path[64];
+    int count = 0;
+    while (count < 64) {
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", count);
+        if (access(path, F_OK) != 0)
+            break;
+        count++;
+    }
+    return count ? count : 1;
+}
+
+// The NUMA node of the calling thread: the one of its CPU, or with simulated nodes,
+// the one its thread number falls on
+static int shard_thread_node(const Shard_Skiplist* sl) {
+    if (sl->simulated)
+        return omp_get_thread_num() * sl->numa_nodes / omp_get_num_threads();
+#ifdef SYS_getcpu
+    unsigned cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0 && (int)node < sl->numa_nodes)
+        return node;
+#endif
+    return 0;
+}
+
+Shard_Skiplist* shard_skiplist_init_with(const Skiplist_Config* config, int lo, int hi) {
+    Shard_Skiplist* sl = (Shard_Skiplist*)malloc(sizeof(Shard_Skiplist));
+    int present = numa_nodes_present();
+    sl->numa_nodes = config && config->numa_nodes > 0 ? config->numa_nodes : present;
+    sl->simulated = sl->numa_nodes > present;
+    sl->shards = config && config->shards > 0 ? config->shards : sl->numa_nodes;
+    sl->bounds = (int*)malloc((sl->shards + 1) * sizeof(int));
+    sl->nodes = (int*)malloc(sl->shards * sizeof(int));
+    sl->lists = (FGL_Skiplist**)malloc(sl->shards * sizeof(FGL_Skiplist*));
+    Skiplist_Config shard_config = config ? *config : (Skiplist_Config){ 0 };
+    shard_config.alloc = ALLOC_SLAB;
+    for (int s = 0; s <= sl->shards; s++) {
+        sl->bounds[s] = (int)(lo + ((long long)hi - lo) * s / sl->shards);
+    }
+    for (int s = 0; s < sl->shards; s++) {
+        sl->nodes[s] = (int)((long long)s * sl->numa_nodes / sl->shards);
+        // Binding only pays off with more than one real node
+        bool bind = present > 1 && sl->nodes[s] < present;
+        sl->lists[s] = fgl_skiplist_create(&shard_config, bind ? sl->nodes[s] : -1);
+    }
+    return sl;
+}
+
+Shard_Skiplist* shard_skiplist_init(int lo, int hi) {
+    return shard_skiplist_init_with(NULL, lo, hi);
+}
+
+// nums must be sorted and distinct; every shard is bulk loaded with its slice of them
+Shard_Skiplist* shard_skiplist_build_sorted_with(const Skiplist_Config* config, int lo, int hi, const int* nums, size_t n) {
+    Shard_Skiplist* sl = shard_skiplist_init_with(config, lo, hi);
+    size_t begin = 0;
+    for (int s = 0; s < sl->shards; s++) {
+        size_t end = begin;
+        while (end < n && (s == sl->shards - 1 || nums[end] < sl->bounds[s + 1])) {
+            end++;
         }
-        // Unlock the current node before moving down
-        omp_unset_lock(&temp->lock);
+        fgl_build_into(sl->lists[s], nums + begin, end - begin);
+        begin = end;
+    }
+    return sl;
+}
+
+// The shard holding num: the last one starting at or below it
+static inline int shard_of(const Shard_Skiplist* sl, int num) {
+    int first = 0, last = sl->shards - 1;
+    while (first < last) {
+        int mid = (first + last + 1) / 2;
+        if (sl->bounds[mid] <= num)
+            first = mid;
+        else
+            last = mid - 1;
+    }
+    return first;
+}
+
+bool Shard_Search(Shard_Skiplist* sl, int num) {
+    return FGL_Search(sl->lists[shard_of(sl, num)], num);
+}
+
+void Shard_Insert(Shard_Skiplist* sl, int num) {
+    FGL_Insert(sl->lists[shard_of(sl, num)], num);
+}
+
+bool Shard_Delete(Shard_Skiplist* sl, int num) {
+    return FGL_Delete(sl->lists[shard_of(sl, num)], num);
+}
+
+// Passes the keys of one shard on to the caller's callback and remembers if it stopped
+typedef struct Shard_Scan {
+    Scan_Fn fn;
+    void* arg;
+    bool stopped;
+} Shard_Scan;
+
+static bool shard_scan_key(int64_t key, void* value, void* arg) {
+    Shard_Scan* scan = (Shard_Scan*)arg;
+    scan->stopped = !scan->fn(key, value, scan->arg);
+    return !scan->stopped;
+}
 
-        temp = temp->down;
-        currentLevel--;
+// Each shard is scanned weakly consistently like FGL_RangeScan, one after the other
+long Shard_RangeScan(Shard_Skiplist* sl, int lo, int hi, Scan_Fn fn, void* arg) {
+    Shard_Scan scan = { fn, arg, false };
+    long count = 0;
+    for (int s = shard_of(sl, lo); s < sl->shards && !scan.stopped && (s == 0 || sl->bounds[s] < hi); s++) {
+        count += FGL_RangeScan(sl->lists[s], lo, hi, shard_scan_key, &scan);
     }
+    return count;
+}
+
+long Shard_Size(Shard_Skiplist* sl) {
+    long count = 0;
+    for (int s = 0; s < sl->shards; s++) {
+        count += FGL_Size(sl->lists[s]);
+    }
+    return count;
+}
 
+// Returns the NUMA node of the calling thread and stores the key range of its shards in
+// [*lo, *hi); a node without a shard of its own is given the shard nearest to its share.
+int Shard_Local(Shard_Skiplist* sl, int* lo, int* hi) {
+    int node = shard_thread_node(sl);
+    int first = 0;
+    while (first < sl->shards - 1 && sl->nodes[first] < node) {
+        first++;
+    }
+    int last = first;
+    while (last < sl->shards - 1 && sl->nodes[last + 1] == node) {
+        last++;
+    }
+    *lo = sl->bounds[first];
+    *hi = sl->bounds[last + 1];
+    return node;
 }
 
 // ======================================================================== //
-// ============================= D E L E T E ============================== //
+// ================== P R I O R I T Y   Q U E U E ========================= //
 // ======================================================================== //
 
-bool Delete(Skiplist* sl, int num) {
-    bool flag = false; // use bool to return false if failed to find thus can't delete
-    Node* temp = sl->head;
-    while (temp) {
-        while (temp->right && temp->right->val < num) {
-            temp = temp->right;
+// PopMin removes the smallest key, which every thread then races for at the head of the
+// list. LF_SprayPopMin relaxes that like the SprayList (Alistarh, Kopinsky, Li, Shavit):
+// with p threads, a random walk from level log p + SPRAY_HEIGHT down jumps 0 to
+// SPRAY_JUMP * log^3 p nodes on every level, so concurrent pops spread over the first
+// O(p log^3 p) keys instead of all contending for the first one.
+#define SPRAY_HEIGHT 1
+#define SPRAY_JUMP 1
+#define SPRAY_ATTEMPTS 8        // sprays that land on keys others took before falling back to LF_PopMin
+
+// The key and value of a Skiplist are stored unless NULL; returns false if the list is empty
+bool PeekMin(Skiplist* sl, int64_t* key, void** value) {
+    Cursor cur;
+    cursor_first(&cur, sl);
+    bool found = Next(&cur, key, value);
+    Cursor_Close(&cur);
+    return found;
+}
+
+// The smallest key is the first one every level of the descent reaches, so the removal stays O(levels)
+bool PopMin(Skiplist* sl, int64_t* key, void** value) {
+    int64_t min;
+    if (!PeekMin(sl, &min, NULL))
+        return false;
+    if (key)
+        *key = min;
+    return Remove(sl, min, value);
+}
+
+bool CGL_PeekMin(Skiplist* sl, int64_t* key, void** value) {
+    read_lock(sl->lock);
+    bool found = PeekMin(sl, key, value);
+    read_unlock(sl->lock);
+    return found;
+}
+
+bool CGL_PopMin(Skiplist* sl, int64_t* key, void** value) {
+    write_lock(sl->lock);
+    bool found = PopMin(sl, key, value);
+    write_unlock(sl->lock);
+    return found;
+}
+
+// The first node that is fully linked and not deleted
+static FGL_Node* fgl_first(FGL_Skiplist* sl) {
+    FGL_Node* node = atomic_load(&sl->head->next[0]);
+    while (node && (!atomic_load(&node->fully_linked) || atomic_load(&node->marked))) {
+        node = atomic_load(&node->next[0]);
+    }
+    return node;
+}
+
+bool FGL_PeekMin(FGL_Skiplist* sl, int* num) {
+    epoch_enter(sl->epoch);
+    FGL_Node* node = fgl_first(sl);
+    if (node && num)
+        *num = node->val;
+    epoch_exit(sl->epoch);
+    return node != NULL;
+}
+
+// Delete the first key; if another thread deleted it first, try the next first one
+bool FGL_PopMin(FGL_Skiplist* sl, int* num) {
+    FGL_Node* preds[MAX_LEVEL];
+    epoch_enter(sl->epoch);
+    bool popped = false;
+    FGL_Node* node;
+    while (!popped && (node = fgl_first(sl))) {
+        int val = node->val;
+        popped = fgl_delete(sl, val, preds, false);
+        if (popped && num)
+            *num = val;
+    }
+    epoch_exit(sl->epoch);
+    return popped;
+}
+
+bool LF_PeekMin(LF_Skiplist* sl, int* num) {
+    epoch_enter(sl->epoch);
+    LF_Node* node = lf_skip_marked(LF_UNMARK(atomic_load(&sl->head->next[0])));
+    if (node && num)
+        *num = node->val;
+    epoch_exit(sl->epoch);
+    return node != NULL;
+}
+
+bool LF_PopMin(LF_Skiplist* sl, int* num) {
+    int val;
+    while (LF_PeekMin(sl, &val)) {
+        if (lf_delete(sl, val)) {
+            if (num)
+                *num = val;
+            return true;
         }
-        if (temp->right && temp->right->val == num) {
-            Node* node = temp->right; // connect the prev and next to delete current node
-            temp->right = node->right;
-            free(node); // free to delete
-            flag = true; // return success
+    }
+    return false;
+}
+
+// Walk a spray from the head; returns the first live bottom node at or after where it lands
+static LF_Node* lf_spray(LF_Skiplist* sl, int log_threads, int slot) {
+    long jump = SPRAY_JUMP * log_threads * log_threads * log_threads;
+    int top = levels_in_use(sl->levels);
+    LF_Node* node = sl->head;
+    for (int level = log_threads + SPRAY_HEIGHT < top ? log_threads + SPRAY_HEIGHT : top - 1; level >= 0; level--) {
+        for (long steps = spray_rand(sl->levels, slot) % (jump + 1); steps > 0; steps--) {
+            LF_Node* next = LF_UNMARK(atomic_load(&node->next[level]));
+            if (!next)
+                break;
+            node = next;
         }
-        temp = temp->down;
     }
-    return flag;
+    if (node == sl->head)
+        node = LF_UNMARK(atomic_load(&sl->head->next[0]));
+    return lf_skip_marked(node);
+}
+
+// Pop one of about the first p log^3 p keys, p being the threads of the calling OpenMP team.
+// Alone, or once sprays keep missing, it pops the smallest key like LF_PopMin.
+bool LF_SprayPopMin(LF_Skiplist* sl, int* num) {
+    int threads = omp_get_num_threads(), slot = thread_slot();
+    int log_threads = 0;
+    while ((1 << log_threads) < threads) {
+        log_threads++;
+    }
+    for (int attempt = 0; threads > 1 && attempt < SPRAY_ATTEMPTS; attempt++) {
+        epoch_enter(sl->epoch);
+        LF_Node* node = lf_spray(sl, log_threads, slot);
+        int val = node ? node->val : 0;
+        epoch_exit(sl->epoch);
+        if (!node)
+            break;      // past the end: too few keys left to spread over
+        if (lf_delete(sl, val)) {
+            if (num)
+                *num = val;
+            return true;
+        }
+    }
+    return LF_PopMin(sl, num);
+}
+
+bool Chunk_PeekMin(Chunk_Skiplist* sl, int* num) {
+    // Only the head chunk is kept when it empties
+    Chunk_Node* chunk = sl->head;
+    while (chunk && chunk->count == 0) {
+        chunk = chunk->next[0];
+    }
+    if (chunk && num)
+        *num = chunk->keys[0];
+    return chunk != NULL;
+}
+
+bool Chunk_PopMin(Chunk_Skiplist* sl, int* num) {
+    int min;
+    if (!Chunk_PeekMin(sl, &min))
+        return false;
+    if (num)
+        *num = min;
+    return Chunk_Delete(sl, min);
+}
+
+bool Shard_PeekMin(Shard_Skiplist* sl, int* num) {
+    for (int s = 0; s < sl->shards; s++) {
+        if (FGL_PeekMin(sl->lists[s], num))
+            return true;
+    }
+    return false;
+}
+
+bool Shard_PopMin(Shard_Skiplist* sl, int* num) {
+    for (int s = 0; s < sl->shards; s++) {
+        if (FGL_PopMin(sl->lists[s], num))
+            return true;
+    }
+    return false;
 }
 
 // ======================================================================== //
-// ================= C O A R S E  L O C K  D E L E T E ==================== //
+// ======================= P E R S I S T E N C E ========================== //
 // ======================================================================== //
 
-bool CGL_Delete(Skiplist* sl, int num) {
-    // Lock the whole list
-    omp_set_lock(&coarse_grained_lock);
-    bool flag = false;
-    Node* temp = sl->head;
-    while (temp) {
-        while (temp->right && temp->right->val < num) {
-            temp = temp->right;
+static size_t cache_line_round(size_t bytes) {
+    return (bytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+}
+
+// Write bytes, then zeros up to the next cache line
+static bool write_padded(FILE* file, const void* data, size_t bytes) {
+    static const char zeros[CACHE_LINE];
+    size_t pad = cache_line_round(bytes) - bytes;
+    return fwrite(data, 1, bytes, file) == bytes && fwrite(zeros, 1, pad, file) == pad;
+}
+
+// Write every key of the list, overlay and snapshot merged, to a snapshot file. Values are
+// written as raw 64-bit words, so only integers stored in them survive a reload.
+// Returns false for lists with a comparator or byte keys and on I/O errors.
+bool skiplist_save(Skiplist* sl, const char* path) {
+    if (sl->cmp || sl->key_width)
+        return false;
+    size_t count = 0, capacity = 1024;
+    int64_t* keys = (int64_t*)malloc(capacity * sizeof(int64_t));
+    uint64_t* values = (uint64_t*)malloc(capacity * sizeof(uint64_t));
+    Cursor cur;
+    int64_t key;
+    void* value;
+    Seek(&cur, sl, INT64_MIN);
+    while (Next(&cur, &key, &value)) {
+        if (count == capacity) {
+            capacity *= 2;
+            keys = (int64_t*)realloc(keys, capacity * sizeof(int64_t));
+            values = (uint64_t*)realloc(values, capacity * sizeof(uint64_t));
         }
-        if (temp->right && temp->right->val == num) {
-            Node* node = temp->right;
-            temp->right = node->right;
-            free(node);
-            flag = true;
+        keys[count] = key;
+        values[count++] = (uint64_t)(uintptr_t)value;
+    }
+    Cursor_Close(&cur);
+
+    Snapshot_Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, 8);
+    header.version = SNAPSHOT_VERSION;
+    int64_t* level_keys[SNAPSHOT_LEVELS] = { keys };
+    header.count[0] = count;
+    header.levels = 1;
+    while (header.count[header.levels - 1] > SNAPSHOT_FANOUT) {
+        uint32_t level = header.levels++;
+        header.count[level] = (header.count[level - 1] + SNAPSHOT_FANOUT - 1) / SNAPSHOT_FANOUT;
+        level_keys[level] = (int64_t*)malloc(header.count[level] * sizeof(int64_t));
+        for (uint64_t i = 0; i < header.count[level]; i++) {
+            level_keys[level][i] = level_keys[level - 1][i * SNAPSHOT_FANOUT];
         }
-        temp = temp->down;
     }
-    omp_unset_lock(&coarse_grained_lock);
-    return flag;
+    uint64_t offset = cache_line_round(sizeof(header));
+    for (uint32_t level = 0; level < header.levels; level++) {
+        header.offset[level] = offset;
+        offset += cache_line_round(header.count[level] * sizeof(int64_t));
+    }
+    header.values_offset = offset;
+    header.keys_checksum = snapshot_checksum(keys, count * sizeof(int64_t));
+    header.index_checksum = snapshot_index_checksum(&header, (const int64_t* const*)level_keys);
+    header.values_checksum = snapshot_checksum(values, count * sizeof(uint64_t));
+    header.header_checksum = snapshot_checksum(&header, sizeof(header));
+
+    FILE* file = fopen(path, "wb");
+    bool ok = file && write_padded(file, &header, sizeof(header));
+    for (uint32_t level = 0; ok && level < header.levels; level++) {
+        ok = write_padded(file, level_keys[level], header.count[level] * sizeof(int64_t));
+    }
+    ok = ok && write_padded(file, values, count * sizeof(uint64_t));
+    if (file)
+        ok = fclose(file) == 0 && ok;
+    for (uint32_t level = 1; level < header.levels; level++) {
+        free(level_keys[level]);
+    }
+    free(keys);
+    free(values);
+    return ok;
 }
 
-// ======================================================================== //
-// =========== F I N E - G R A I N E D  L O C K  D E L E T E ============== //
-// ======================================================================== //
+// The list searches the mapped file in place and keeps its writes in memory; they reach
+// the file only through another skiplist_save. Returns NULL if the file is not a valid snapshot.
+Skiplist* skiplist_open_mmap(const char* path) {
+    Snapshot* snap = snapshot_map(path);
+    if (!snap)
+        return NULL;
+    Skiplist* sl = skiplist_init();
+    sl->base = snap;
+    size_add(sl->size, snap->count);
+    return sl;
+}
 
-bool FGL_Delete(FGL_Skiplist* sl, int num) {
-    FGL_Node* temp = sl->head;
-    bool flag = false;
+// Check the keys and values of the list's snapshot against their checksums. Opening only
+// checks the header and index, so this is the one call that reads the whole file.
+bool skiplist_verify(Skiplist* sl) {
+    const Snapshot* snap = sl->base;
+    if (!snap)
+        return true;
+    return snapshot_checksum(snap->level_keys[0], snap->count * sizeof(int64_t)) == snap->header->keys_checksum &&
+           snapshot_checksum(snap->values, snap->count * sizeof(uint64_t)) == snap->header->values_checksum;
+}
 
-    // Lock the head node before traversal
-    omp_set_lock(&temp->lock);
+// Write every byte, retrying short writes
+static bool write_all(int fd, const void* data, size_t bytes) {
+    const char* p = (const char*)data;
+    while (bytes > 0) {
+        ssize_t done = write(fd, p, bytes);
+        if (done < 0 && errno == EINTR)
+            continue;
+        if (done <= 0)
+            return false;
+        p += done;
+        bytes -= done;
+    }
+    return true;
+}
 
-    while (temp) {
-        FGL_Node* curr = temp->right;
+static bool read_all(int fd, void* data, size_t bytes) {
+    char* p = (char*)data;
+    while (bytes > 0) {
+        ssize_t done = read(fd, p, bytes);
+        if (done < 0 && errno == EINTR)
+            continue;
+        if (done <= 0)
+            return false;
+        p += done;
+        bytes -= done;
+    }
+    return true;
+}
 
-        // Lock the current node before traversal
-        if (curr)
-            omp_set_lock(&curr->lock);
+static int wal_lsn_compare(const void* a, const void* b) {
+    const Wal_Record* x = (const Wal_Record*)a;
+    const Wal_Record* y = (const Wal_Record*)b;
+    return (x->lsn > y->lsn) - (x->lsn < y->lsn);
+}
 
-        FGL_Node* prev = NULL;
-        while (curr && curr->val < num) {
-            // Unlock the previous node
-            if (prev)
-                omp_unset_lock(&prev->lock);
-            prev = curr;
-            curr = curr->right;
-            // Lock the new current node
-            if (curr)
-                omp_set_lock(&curr->lock);
-        }
-        if (curr && curr->val == num) {
-            // Unlock the previous node
-            if (prev)
-                omp_unset_lock(&prev->lock);
-
-            // Remove the current node
-            if (prev)
-                prev->right = curr->right;
-            else
-                temp->right = curr->right;
-
-            FGL_Node* node = curr;
-            omp_unset_lock(&curr->lock);
-            free(node);
-            flag = true;
-        } else {
-            // Unlock the previous and current nodes
-            if (prev)
-                omp_unset_lock(&prev->lock);
-            if (curr)
-                omp_unset_lock(&curr->lock);
+// Drain every thread's buffer, then write and fsync as one group the records that continue
+// the file without a gap. A record whose predecessor was still being appended when its
+// buffer was drained waits for the next group; a sync never waits for those, as its own
+// records were all appended before the drain.
+static bool wal_flush(Wal* wal) {
+    size_t n = wal->held;
+    for (int t = 0; t <= MAX_THREADS; t++) {
+        Wal_Buffer* buf = &wal->buffers[t];
+        pthread_mutex_lock(&buf->lock);
+        if (n + buf->count > wal->out_capacity) {
+            wal->out_capacity = 2 * (n + buf->count);
+            wal->out = (Wal_Record*)realloc(wal->out, wal->out_capacity * sizeof(Wal_Record));
         }
-        temp = temp->down;
-        if (temp) {
-            // Lock the next level node before traversal
-            omp_set_lock(&temp->lock);
+        memcpy(wal->out + n, buf->records, buf->count * sizeof(Wal_Record));
+        n += buf->count;
+        buf->count = 0;
+        pthread_mutex_unlock(&buf->lock);
+    }
+    if (n == wal->held)
+        return true;
+    atomic_fetch_sub(&wal->pending, n - wal->held);
+    qsort(wal->out, n, sizeof(Wal_Record), wal_lsn_compare);
+    size_t ready = 0;
+    while (ready < n && wal->out[ready].lsn == wal->written + ready) {
+        ready++;
+    }
+    bool ok = ready == 0 || (write_all(wal->fd, wal->out, ready * sizeof(Wal_Record)) && fdatasync(wal->fd) == 0);
+    wal->written += ready;
+    wal->held = n - ready;
+    memmove(wal->out, wal->out + ready, wal->held * sizeof(Wal_Record));
+    return ok;
+}
+
+static void* wal_flusher(void* arg) {
+    Wal* wal = (Wal*)arg;
+    pthread_mutex_lock(&wal->mutex);
+    for (;;) {
+        // Sleep until a group is full, a sync is waiting, or a partial group has waited long enough
+        while (!wal->stop && wal->requested == wal->completed && atomic_load(&wal->pending) < wal->group) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += WAL_INTERVAL_NS;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            if (pthread_cond_timedwait(&wal->wake, &wal->mutex, &deadline) == ETIMEDOUT &&
+                atomic_load(&wal->pending) > 0)
+                break;
         }
+        // Every sync that took a ticket up to here appended its records before
+        uint64_t ticket = wal->requested;
+        bool stop = wal->stop;
+        pthread_mutex_unlock(&wal->mutex);
+        bool ok = wal_flush(wal);
+        pthread_mutex_lock(&wal->mutex);
+        wal->failed = wal->failed || !ok;
+        wal->completed = ticket;
+        pthread_cond_broadcast(&wal->done);
+        if (stop)
+            break;
     }
+    pthread_mutex_unlock(&wal->mutex);
+    return NULL;
+}
 
-    return flag;
+// Flush what is left and stop the flusher
+static void wal_close(Wal* wal) {
+    pthread_mutex_lock(&wal->mutex);
+    wal->stop = true;
+    pthread_cond_signal(&wal->wake);
+    pthread_mutex_unlock(&wal->mutex);
+    pthread_join(wal->flusher, NULL);
+    for (int t = 0; t <= MAX_THREADS; t++) {
+        pthread_mutex_destroy(&wal->buffers[t].lock);
+        free(wal->buffers[t].records);
+    }
+    pthread_mutex_destroy(&wal->mutex);
+    pthread_cond_destroy(&wal->wake);
+    pthread_cond_destroy(&wal->done);
+    close(wal->fd);
+    free(wal->out);
+    free(wal);
+}
+
+static int wal_record_compare(const void* a, const void* b) {
+    const Wal_Record* x = (const Wal_Record*)a;
+    const Wal_Record* y = (const Wal_Record*)b;
+    if (x->key != y->key)
+        return x->key < y->key ? -1 : 1;
+    return (x->lsn > y->lsn) - (x->lsn < y->lsn);
+}
+
+// Sorted by key and sequence number, the writes to each key fold into a number of towers,
+// the first holding the last value stored; the result is bulk loaded into the empty list.
+// Remove may pick any of several equal towers, so with duplicate keys only their count is exact.
+static void wal_replay(Skiplist* sl, Wal_Record* records, size_t n) {
+    qsort(records, n, sizeof(Wal_Record), wal_record_compare);
+    int64_t* keys = (int64_t*)malloc(n * sizeof(int64_t));
+    void** values = (void**)malloc(n * sizeof(void*));
+    size_t count = 0;
+    for (size_t i = 0; i < n;) {
+        int64_t key = records[i].key;
+        size_t towers = 0;
+        uint64_t value = 0;
+        for (; i < n && records[i].key == key; i++) {
+            if (records[i].op == WAL_INSERT) {
+                towers++;   // a new tower goes in front of the equal ones
+                value = records[i].value;
+            } else if (records[i].op == WAL_PUT) {
+                towers += towers == 0;
+                value = records[i].value;
+            } else if (towers > 0) {
+                towers--;
+                value = 0;
+            }
+        }
+        for (size_t t = 0; t < towers; t++) {
+            keys[count] = key;
+            values[count++] = t == 0 ? (void*)(uintptr_t)value : NULL;
+        }
+    }
+    build_into(sl, keys, values, count);
+    free(keys);
+    free(values);
+}
+
+// Open the log at path, creating it if needed, replay it into a fresh list made with config,
+// and log every later write to that list. A torn record at the end, left by a crash in the
+// middle of a write, is cut off, and so is everything from the first gap in the sequence
+// numbers on. Writes are durable once skiplist_wal_sync returns; values
+// are logged as raw 64-bit words like in snapshots. Returns NULL for lists with a comparator
+// or byte keys, for a file that is not a log, and on I/O errors.
+Skiplist* skiplist_open_wal(const Skiplist_Config* config, const char* path) {
+    if (config && (config->cmp || config->key_width))
+        return NULL;
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return NULL;
+    Wal_Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, WAL_MAGIC, 8);
+    header.version = WAL_VERSION;
+    header.record_size = sizeof(Wal_Record);
+
+    struct stat st;
+    char* data = NULL;
+    Wal_Record* records = NULL;
+    size_t n = 0;
+    bool ok = fstat(fd, &st) == 0;
+    if (ok && st.st_size == 0) {
+        ok = write_all(fd, &header, sizeof(header)) && fsync(fd) == 0;
+    } else if (ok) {
+        data = (char*)malloc(st.st_size);
+        ok = read_all(fd, data, st.st_size) && (size_t)st.st_size >= sizeof(header) &&
+             memcmp(data, &header, sizeof(header)) == 0;
+        records = (Wal_Record*)(data + sizeof(header));
+        size_t max = ok ? (st.st_size - sizeof(header)) / sizeof(Wal_Record) : 0;
+        while (n < max && records[n].lsn == n && records[n].op <= WAL_DELETE &&
+               wal_checksum(&records[n]) == records[n].checksum) {
+            n++;
+        }
+        off_t valid = sizeof(header) + n * sizeof(Wal_Record);
+        if (ok && valid < st.st_size)
+            ok = ftruncate(fd, valid) == 0 && fsync(fd) == 0;
+        ok = ok && lseek(fd, valid, SEEK_SET) == valid;
+    }
+    if (!ok) {
+        free(data);
+        close(fd);
+        return NULL;
+    }
+
+    Skiplist* sl = skiplist_init_with(config);
+    Wal* wal = (Wal*)aligned_alloc(CACHE_LINE, sizeof(Wal));
+    memset(wal, 0, sizeof(Wal));
+    if (data) {
+        wal_replay(sl, records, n);
+        free(data);
+    }
+    for (int t = 0; t <= MAX_THREADS; t++) {
+        pthread_mutex_init(&wal->buffers[t].lock, NULL);
+    }
+    wal->fd = fd;
+    wal->group = config && config->wal_group ? config->wal_group : WAL_GROUP;
+    atomic_init(&wal->lsn, n);
+    wal->written = n;
+    atomic_init(&wal->pending, 0);
+    pthread_mutex_init(&wal->mutex, NULL);
+    pthread_cond_init(&wal->wake, NULL);
+    pthread_cond_init(&wal->done, NULL);
+    pthread_create(&wal->flusher, NULL, wal_flusher, wal);
+    sl->wal = wal;
+    return sl;
+}
+
+// Wait until every write made before the call, by this thread or any thread it synchronized
+// with, is on disk. Returns false for a list without a log or if writing the log failed.
+bool skiplist_wal_sync(Skiplist* sl) {
+    Wal* wal = sl->wal;
+    if (!wal)
+        return false;
+    pthread_mutex_lock(&wal->mutex);
+    uint64_t ticket = ++wal->requested;
+    pthread_cond_signal(&wal->wake);
+    while (wal->completed < ticket) {
+        pthread_cond_wait(&wal->done, &wal->mutex);
+    }
+    bool ok = !wal->failed;
+    pthread_mutex_unlock(&wal->mutex);
+    return ok;
 }
 
 // ======================================================================== //
@@ -347,12 +4600,24 @@ bool FGL_Delete(FGL_Skiplist* sl, int num) {
 // ======================================================================== //
 
 void skiplistFree(Skiplist* sl) {
-    Node* temp = sl->head;
-    while (temp) {
-        Node* del = temp;
-        temp = temp->down;
-        free(del);  // free every node
+    if (sl->wal)
+        wal_close(sl->wal);
+    // Slab allocated nodes are released in bulk with their slabs
+    if (sl->alloc->type == ALLOC_MALLOC) {
+        Node* temp = sl->head;
+        while (temp) {
+            Node* del = temp;
+            temp = temp->next[0];
+            free(del);  // free every node
+        }
     }
+    epoch_free(sl->epoch);
+    allocator_free(sl->alloc);
+    free(sl->levels);
+    free(sl->size);
+    coarse_lock_free(sl->lock);
+    if (sl->base)
+        snapshot_unmap(sl->base);
     free(sl);
 }
 
@@ -360,8 +4625,57 @@ void FGL_skiplistFree(FGL_Skiplist* sl) {
     FGL_Node* temp = sl->head;
     while (temp) {
         FGL_Node* del = temp;
-        temp = temp->down;
-        free(del); // free every node
+        temp = atomic_load(&temp->next[0]);
+        omp_destroy_lock(&del->lock);
+        if (sl->alloc->type == ALLOC_MALLOC)
+            free(del); // free every node
+    }
+    pivots_free(sl->pivots, sl);
+    epoch_free(sl->epoch);
+    allocator_free(sl->alloc);
+    free(sl->levels);
+    free(sl->size);
+    free(sl);
+}
+
+void Chunk_skiplistFree(Chunk_Skiplist* sl) {
+    if (sl->alloc->type == ALLOC_MALLOC) {
+        Chunk_Node* temp = sl->head;
+        while (temp) {
+            Chunk_Node* del = temp;
+            temp = temp->next[0];
+            free(del);  // free every chunk
+        }
+    }
+    allocator_free(sl->alloc);
+    free(sl->levels);
+    free(sl);
+}
+
+void Shard_skiplistFree(Shard_Skiplist* sl) {
+    for (int s = 0; s < sl->shards; s++) {
+        FGL_skiplistFree(sl->lists[s]);
+    }
+    free(sl->lists);
+    free(sl->nodes);
+    free(sl->bounds);
+    free(sl);
+}
+
+void LF_skiplistFree(LF_Skiplist* sl) {
+    if (sl->alloc->type == ALLOC_MALLOC) {
+        LF_Node* temp = LF_UNMARK(atomic_load(&sl->head->next[0]));
+        while (temp) {
+            LF_Node* del = temp;
+            temp = LF_UNMARK(atomic_load(&temp->next[0]));
+            free(del);  // free every node still on the bottom level
+        }
+        free(sl->head);
     }
+    pivots_free(sl->pivots, sl);
+    epoch_free(sl->epoch);
+    allocator_free(sl->alloc);
+    free(sl->levels);
+    free(sl->size);
     free(sl);
 }
\ No newline at end of file
@@ -2,62 +2,352 @@
 #define SKIPLIST_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
 #include <omp.h>
 
-#define MAX_LEVEL 10
+#define MAX_LEVEL 32                    // tallest tower any list can be configured with
 #define MAX_INT 2147483647
 
-// Global variables
-extern double cpu_time, 
-              insert_start, insert_end, 
-              search_start, search_end, 
-              delete_start, delete_end,
-              par_insert_start, par_insert_end, 
-              par_search_start, par_search_end, 
-              par_delete_start, par_delete_end;
-extern omp_lock_t coarse_grained_lock;
+// Node allocators: plain malloc/free, or per-thread slabs of fixed-size blocks released in bulk with the list
+typedef enum Alloc_Type {
+    ALLOC_MALLOC,
+    ALLOC_SLAB
+} Alloc_Type;
+
+typedef struct Node_Allocator Node_Allocator;  // defined in skiplist.c
+
+// Epoch-based reclamation: deleted nodes are retired and freed only once no thread can still be reading them
+typedef struct Epoch_Domain Epoch_Domain;      // defined in skiplist.c
+
+// Coarse-grained lock of a Skiplist: a mutex, or a reader-writer lock with per-thread reader counters
+typedef enum Lock_Type {
+    LOCK_MUTEX,
+    LOCK_RW
+} Lock_Type;
+
+typedef struct Coarse_Lock Coarse_Lock;        // defined in skiplist.c
+typedef struct Snapshot Snapshot;              // defined in skiplist.c
+typedef struct Wal Wal;                        // defined in skiplist.c
+
+// Element count of a list, sharded per thread so concurrent writers do not share a counter
+typedef struct Size_Counter Size_Counter;      // defined in skiplist.c
+
+// Read-only array of towers that FGL and LF descents start from instead of the head
+typedef struct Pivot_Index Pivot_Index;        // defined in skiplist.c
+
+// Orders two keys like strcmp; keys that do not fit in 64 bits are passed as pointers
+typedef int (*Key_Cmp)(int64_t a, int64_t b);
+
+// Options picked when a list is created; pass NULL to the *_init_with functions for the defaults
+typedef struct Skiplist_Config {
+    Alloc_Type alloc;                   // ALLOC_MALLOC by default
+    double p;                           // probability of promoting a node one level up; 0 means 1/2
+    uint64_t seed;                      // seeds the per-thread level generators; 0 means a fixed default
+    Key_Cmp cmp;                        // Skiplist keys: NULL compares them as signed integers
+    size_t key_width;                   // Skiplist keys: if set, keys point to key_width bytes compared with memcmp
+    Lock_Type lock;                     // Skiplist CGL_* functions: LOCK_MUTEX by default
+    size_t wal_group;                   // skiplist_open_wal: records written per fsync; 0 means 64
+    int max_level;                      // tallest tower and height of the head, 1..MAX_LEVEL; 0 means MAX_LEVEL
+    bool fixed_levels;                  // use all max_level levels from the start instead of growing them with the list
+    bool indexed;                       // Skiplist: every link carries its span, for Rank and Select in O(log n)
+    int shards;                         // Shard lists: key ranges; 0 means one per NUMA node
+    int numa_nodes;                     // Shard lists: NUMA nodes to spread the shards over; 0 means the machine's, more are simulated
+    bool head_only;                     // FGL and LF lists: start every descent at the head, without a pivot index
+} Skiplist_Config;
+
+// Per-thread random level generators of a list
+typedef struct Level_Gen Level_Gen;            // defined in skiplist.c
+
+// Kernels counting the keys less than a probe in a sorted array, one per instruction set
+typedef enum Rank_Kernel {
+    RANK_SCALAR,
+    RANK_SSE42,
+    RANK_AVX2
+} Rank_Kernel;
+
+// Hot-path counters of every list, summed over the threads. They are only kept when
+// skiplist.c is compiled with -DSKIPLIST_STATS; otherwise the hooks compile to nothing.
+#define STATS_BUCKETS 32                // latency bucket b counts operations of [2^b, 2^(b+1)) ns
+
+typedef enum Stat_Op {
+    STAT_SEARCH,                        // Search, Get, FGL_/LF_/Chunk_Search
+    STAT_INSERT,                        // Insert, Put and the FGL_/LF_/Chunk_ inserts
+    STAT_DELETE,                        // Delete, Remove and the FGL_/LF_/Chunk_ deletes
+    STAT_SCAN,                          // every range scan
+    STAT_OPS
+} Stat_Op;
+
+typedef struct Skiplist_Stats {
+    long ops[STAT_OPS];
+    long latency[STAT_OPS][STATS_BUCKETS];  // log2 histogram of the time of each operation
+    long visited[MAX_LEVEL];            // nodes stepped over on each level by searches and writers
+    long lock_acquires;                 // list and node locks taken
+    long lock_contended;                // ... of which were held by another thread
+    long lock_wait_ns;                  // time spent waiting for contended locks
+    long retries;                       // failed CASes and validations that redo part of an operation
+    long allocs;                        // nodes allocated
+} Skiplist_Stats;
+
+// Shape and memory of one list (skiplist_profile)
+typedef struct Level_Profile {
+    long nodes;                         // towers reaching this level
+    double mean_gap;                    // links of the level below that one link of this level skips; ideally 1/p
+    long max_gap;                       // ... the longest one seen
+    size_t bytes;                       // forward pointers and spans of the level; level 1 also has the node headers
+} Level_Profile;
+
+typedef struct Skiplist_Profile {
+    double sample;                      // fraction of the list walked: counts are exact at 1, estimates below
+    double p;                           // promotion probability
+    int levels;                         // levels in use
+    long nodes;                         // towers, tombstones included
+    Level_Profile level[MAX_LEVEL];
+    long heights[MAX_LEVEL];            // heights[h - 1]: towers of height h
+    double ideal[MAX_LEVEL];            // ... expected from a geometric distribution capped at the levels in use
+    size_t node_bytes;                  // heap blocks of the towers
+    size_t sentinel_bytes;              // the head tower
+    size_t list_bytes;                  // list header, allocator, epochs, level generator, lock and size counter
+    size_t heap_bytes;                  // all of it; with ALLOC_SLAB every slab counts whole, free blocks included
+} Skiplist_Profile;
 
 // Skiplist structures for sequential and coarse-grained lock versions
 typedef struct Node {
-    int val;                            // each node has a val as key
-    struct Node *right, *down;          // 2d singly linked
+    int64_t key;                        // each node has a key ...
+    void* value;                        // ... mapped to a value, so a lookup needs no second table
+    int level;                          // height of the tower, 1..MAX_LEVEL
+    struct Node* next[];                // one forward pointer per level, allocated with the node;
+                                        // in an indexed list followed by one span per level
 } Node;
 
 typedef struct Skiplist {
-    Node* head;                         // the top and first node of the skip list
+    Node* head;                         // a single head tower of max_level forward pointers
+    Node_Allocator* alloc;              // where the nodes come from
+    Epoch_Domain* epoch;                // holds deleted nodes until concurrent readers are done with them
+    Level_Gen* levels;                  // draws the height of every new tower
+    Key_Cmp cmp;                        // NULL for integer keys
+    size_t key_width;                   // non-zero for fixed-width byte keys
+    Coarse_Lock* lock;                  // taken by the CGL_* functions
+    Snapshot* base;                     // memory-mapped snapshot under the towers, NULL if none
+    Wal* wal;                           // write-ahead log of every write, NULL if none
+    Size_Counter* size;                 // number of keys
+    bool indexed;                       // nodes carry spans (Skiplist_Config.indexed)
 } Skiplist;
 
-// Skiplist structures for fine-grained lock version
+// Skiplist structures for fine-grained lock version (lazy synchronization)
 typedef struct FGL_Node {
     int val;
-    struct FGL_Node *right, *down;
+    int level;
     omp_lock_t lock;                    // added a lock for each FGL_Node
+    _Atomic bool marked;                // logically deleted
+    _Atomic bool fully_linked;          // linked on every level of its tower
+    _Atomic(struct FGL_Node*) next[];
 } FGL_Node;
 
 typedef struct FGL_Skiplist {
     FGL_Node* head;
+    Node_Allocator* alloc;
+    Epoch_Domain* epoch;
+    Level_Gen* levels;
+    Size_Counter* size;
+    Pivot_Index* pivots;                // NULL with head_only
 } FGL_Skiplist;
 
+// Skiplist structures for lock-free version
+typedef struct LF_Node {
+    int val;
+    int level;                          // height of the tower, 1..MAX_LEVEL
+    _Atomic int votes;                  // inserter and deleter both vote before the node is retired
+    _Atomic uintptr_t next[];           // one forward pointer per level; low bit marks logical deletion
+} LF_Node;
+
+typedef struct LF_Skiplist {
+    LF_Node* head;                      // a single head tower of max_level forward pointers
+    Node_Allocator* alloc;
+    Epoch_Domain* epoch;
+    Level_Gen* levels;
+    Size_Counter* size;
+    Pivot_Index* pivots;                // NULL with head_only
+} LF_Skiplist;
+
+// Skiplist structure for the sharded version: fine-grained lock lists over consecutive key
+// ranges, each taking its nodes from slabs bound to one NUMA node
+typedef struct Shard_Skiplist {
+    int shards;
+    int* bounds;                        // shard i holds [bounds[i], bounds[i + 1]); keys past either end go to the end shards
+    int* nodes;                         // NUMA node of every shard, in ascending blocks
+    int numa_nodes;
+    bool simulated;                     // more nodes than the machine has: threads get theirs by thread number
+    FGL_Skiplist** lists;
+} Shard_Skiplist;
+
+// Skiplist structures for the chunked version: the bottom level is unrolled into sorted
+// arrays of keys, and the levels above index chunks by their first key
+#define CHUNK_KEYS 16                   // one cache line of int keys
+
+typedef struct Chunk_Node {
+    int keys[CHUNK_KEYS];               // sorted; the slots past count hold MAX_INT
+    int count;
+    int level;                          // height of the tower, 1..MAX_LEVEL
+    struct Chunk_Node* next[];
+} Chunk_Node;
+
+typedef struct Chunk_Skiplist {
+    Chunk_Node* head;                   // a full height tower holding the smallest keys
+    Node_Allocator* alloc;
+    Level_Gen* levels;
+} Chunk_Skiplist;
+
+// Cursors for forward iteration in key order; see skiplist.c for their consistency guarantees
+typedef struct Cursor {
+    Skiplist* sl;
+    Node* node;                         // the next node to report, NULL past the end
+    size_t base;                        // the next snapshot key to report
+    bool locked;                        // holds the coarse-grained lock (CGL_Seek)
+} Cursor;
+
+typedef struct FGL_Cursor {
+    FGL_Skiplist* sl;
+    FGL_Node* node;
+} FGL_Cursor;
+
+typedef struct LF_Cursor {
+    LF_Skiplist* sl;
+    LF_Node* node;
+} LF_Cursor;
+
+// Called for every key of a range scan, value is NULL for the int sets; return false to stop the scan
+typedef bool (*Scan_Fn)(int64_t key, void* value, void* arg);
+
 // Functions:
 
 // Sequential
 Skiplist* skiplist_init();
+Skiplist* skiplist_init_with(const Skiplist_Config* config);
+Skiplist* skiplist_build_sorted(const int64_t* keys, size_t n);
+Skiplist* skiplist_build_sorted_with(const Skiplist_Config* config, const int64_t* keys, void* const* values, size_t n);
 bool Search(Skiplist* sl, int num);
 void Insert(Skiplist* sl, int num);
 bool Delete(Skiplist* sl, int num);
+void SearchBatch(Skiplist* sl, const int64_t* keys, size_t n, bool* results);
+
+// Sequential key/value map on the same list; Search/Insert/Delete above work on int keys with NULL values
+bool Put(Skiplist* sl, int64_t key, void* value);
+bool Get(Skiplist* sl, int64_t key, void** value);
+bool Remove(Skiplist* sl, int64_t key, void** value);
+long RangeScan(Skiplist* sl, int64_t lo, int64_t hi, Scan_Fn fn, void* arg);
+void Seek(Cursor* cur, Skiplist* sl, int64_t key);
+bool Next(Cursor* cur, int64_t* key, void** value);
+void Cursor_Close(Cursor* cur);
+void InsertBatch(Skiplist* sl, const int64_t* keys, size_t n);
+long DeleteBatch(Skiplist* sl, const int64_t* keys, size_t n);
+void skiplist_merge(Skiplist* dst, Skiplist* src);
+Skiplist* skiplist_union(Skiplist* a, Skiplist* b);
+Skiplist* skiplist_intersection(Skiplist* a, Skiplist* b);
+Skiplist* skiplist_difference(Skiplist* a, Skiplist* b);
+bool skiplist_save(Skiplist* sl, const char* path);
+Skiplist* skiplist_open_mmap(const char* path);
+bool skiplist_verify(Skiplist* sl);
+Skiplist* skiplist_open_wal(const Skiplist_Config* config, const char* path);
+bool skiplist_wal_sync(Skiplist* sl);
+long Size(Skiplist* sl);
+long Rank(Skiplist* sl, int64_t key);
+bool Select(Skiplist* sl, long k, int64_t* key, void** value);
 
 // Coarse_grained Lock
+bool CGL_Search(Skiplist* sl, int num);
+bool CGL_Get(Skiplist* sl, int64_t key, void** value);
 void CGL_Insert(Skiplist* sl, int num);
 bool CGL_Delete(Skiplist* sl, int num);
+bool CGL_Put(Skiplist* sl, int64_t key, void* value);
+bool CGL_Remove(Skiplist* sl, int64_t key, void** value);
+long CGL_RangeScan(Skiplist* sl, int64_t lo, int64_t hi, Scan_Fn fn, void* arg);
+void CGL_Seek(Cursor* cur, Skiplist* sl, int64_t key);
+void CGL_InsertBatch(Skiplist* sl, const int64_t* keys, size_t n);
+long CGL_DeleteBatch(Skiplist* sl, const int64_t* keys, size_t n);
+long CGL_Rank(Skiplist* sl, int64_t key);
+bool CGL_Select(Skiplist* sl, long k, int64_t* key, void** value);
+bool PeekMin(Skiplist* sl, int64_t* key, void** value);
+bool PopMin(Skiplist* sl, int64_t* key, void** value);
+bool CGL_PeekMin(Skiplist* sl, int64_t* key, void** value);
+bool CGL_PopMin(Skiplist* sl, int64_t* key, void** value);
+void skiplist_profile(Skiplist* sl, double sample, Skiplist_Profile* profile);
+void skiplist_profile_print(const Skiplist_Profile* profile);
 
 // Fine_grained Lock
 FGL_Skiplist* fgl_skiplist_init();
+FGL_Skiplist* fgl_skiplist_init_with(const Skiplist_Config* config);
+FGL_Skiplist* fgl_skiplist_build_sorted(const int* nums, size_t n);
+FGL_Skiplist* fgl_skiplist_build_sorted_with(const Skiplist_Config* config, const int* nums, size_t n);
 bool FGL_Search(FGL_Skiplist* sl, int num);
 void FGL_Insert(FGL_Skiplist* sl, int num);
 bool FGL_Delete(FGL_Skiplist* sl, int num);
+long FGL_RangeScan(FGL_Skiplist* sl, int lo, int hi, Scan_Fn fn, void* arg);
+void FGL_Seek(FGL_Cursor* cur, FGL_Skiplist* sl, int num);
+bool FGL_Next(FGL_Cursor* cur, int* num);
+void FGL_Cursor_Close(FGL_Cursor* cur);
+void FGL_InsertBatch(FGL_Skiplist* sl, const int* nums, size_t n);
+long FGL_DeleteBatch(FGL_Skiplist* sl, const int* nums, size_t n);
+long FGL_Size(FGL_Skiplist* sl);
+bool FGL_PeekMin(FGL_Skiplist* sl, int* num);
+bool FGL_PopMin(FGL_Skiplist* sl, int* num);
+
+// Lock-free
+LF_Skiplist* lf_skiplist_init();
+LF_Skiplist* lf_skiplist_init_with(const Skiplist_Config* config);
+LF_Skiplist* lf_skiplist_build_sorted(const int* nums, size_t n);
+LF_Skiplist* lf_skiplist_build_sorted_with(const Skiplist_Config* config, const int* nums, size_t n);
+bool LF_Search(LF_Skiplist* sl, int num);
+bool LF_Insert(LF_Skiplist* sl, int num);
+bool LF_Delete(LF_Skiplist* sl, int num);
+long LF_InsertBatch(LF_Skiplist* sl, const int* nums, size_t n);
+long LF_DeleteBatch(LF_Skiplist* sl, const int* nums, size_t n);
+long LF_RangeScan(LF_Skiplist* sl, int lo, int hi, Scan_Fn fn, void* arg);
+void LF_Seek(LF_Cursor* cur, LF_Skiplist* sl, int num);
+bool LF_Next(LF_Cursor* cur, int* num);
+void LF_Cursor_Close(LF_Cursor* cur);
+long LF_Size(LF_Skiplist* sl);
+bool LF_PeekMin(LF_Skiplist* sl, int* num);
+bool LF_PopMin(LF_Skiplist* sl, int* num);
+bool LF_SprayPopMin(LF_Skiplist* sl, int* num);
+
+// Sharded over fine-grained lock lists; [lo, hi) is split evenly between the shards
+Shard_Skiplist* shard_skiplist_init(int lo, int hi);
+Shard_Skiplist* shard_skiplist_init_with(const Skiplist_Config* config, int lo, int hi);
+Shard_Skiplist* shard_skiplist_build_sorted_with(const Skiplist_Config* config, int lo, int hi, const int* nums, size_t n);
+bool Shard_Search(Shard_Skiplist* sl, int num);
+void Shard_Insert(Shard_Skiplist* sl, int num);
+bool Shard_Delete(Shard_Skiplist* sl, int num);
+long Shard_RangeScan(Shard_Skiplist* sl, int lo, int hi, Scan_Fn fn, void* arg);
+long Shard_Size(Shard_Skiplist* sl);
+int Shard_Local(Shard_Skiplist* sl, int* lo, int* hi);
+bool Shard_PeekMin(Shard_Skiplist* sl, int* num);
+bool Shard_PopMin(Shard_Skiplist* sl, int* num);
+
+// Chunked, sequential; keys must be less than MAX_INT
+Chunk_Skiplist* chunk_skiplist_init();
+Chunk_Skiplist* chunk_skiplist_init_with(const Skiplist_Config* config);
+bool Chunk_Search(Chunk_Skiplist* sl, int num);
+bool Chunk_Insert(Chunk_Skiplist* sl, int num);
+bool Chunk_Delete(Chunk_Skiplist* sl, int num);
+long Chunk_RangeScan(Chunk_Skiplist* sl, int lo, int hi, Scan_Fn fn, void* arg);
+bool Chunk_PeekMin(Chunk_Skiplist* sl, int* num);
+bool Chunk_PopMin(Chunk_Skiplist* sl, int* num);
 
 // Utilities
 void skiplistFree(Skiplist* sl);
 void FGL_skiplistFree(FGL_Skiplist* sl);
+void LF_skiplistFree(LF_Skiplist* sl);
+void Chunk_skiplistFree(Chunk_Skiplist* sl);
+void Shard_skiplistFree(Shard_Skiplist* sl);
+long allocator_sys_allocs(const Node_Allocator* alloc);
+void epoch_enter(Epoch_Domain* domain);
+void epoch_exit(Epoch_Domain* domain);
+bool skiplist_stats(Skiplist_Stats* stats);
+void skiplist_stats_reset();
+void skiplist_stats_dump();
+Rank_Kernel rank_kernel();
+int rank_keys(Rank_Kernel kernel, const int* keys, int n, int num);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,575 @@
+// Compilation:     gcc-12 -O2 -o skiplist_bench skiplist_bench.c skiplist.c -fopenmp -lm
+// Usage:           ./skiplist_bench [options], ./skiplist_bench -h for the list
+
+#define _GNU_SOURCE                         // sched_setaffinity
+#include "skiplist.h"
+#include <getopt.h>
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_KEYS 1000000                // key space: records 0 .. keys - 1
+#define DEFAULT_OPS 1000000                 // operations per run, split across the threads
+#define DEFAULT_SCAN 100                    // keys per scan
+#define ZIPF_THETA 0.99                     // YCSB's default skew
+
+// ======================================================================== //
+// ========================== W O R K L O A D S =========================== //
+// ======================================================================== //
+
+// Every run starts from half of the key space and applies a mix of operations whose
+// keys are drawn from one distribution, like the YCSB core workloads:
+//   uniform     every record equally likely
+//   zipfian     a few records are hot; their ranks are hashed so they are spread out
+//   sequential  inserts append in key order and deletes take the oldest record
+//   latest      reads favour the records inserted last, which are appended in order
+
+typedef enum Dist {
+    DIST_UNIFORM,
+    DIST_ZIPFIAN,
+    DIST_SEQUENTIAL,
+    DIST_LATEST
+} Dist;
+
+static const char* dist_names[] = { "uniform", "zipfian", "sequential", "latest" };
+
+typedef enum Op {
+    OP_READ,
+    OP_INSERT,
+    OP_DELETE,
+    OP_SCAN,
+    OP_COUNT
+} Op;
+
+// The list variants; the sequential ones only run with one thread
+typedef enum Variant {
+    VAR_SEQ,
+    VAR_CGL,
+    VAR_CGL_RW,
+    VAR_FGL,
+    VAR_LF,
+    VAR_CHUNK,
+    VAR_SHARD,                              // keys of the whole key space
+    VAR_SHARD_LOCAL,                        // every thread keeps to the keys of its NUMA node's shards
+    VAR_COUNT
+} Variant;
+
+static const char* variant_names[] = { "seq", "cgl", "cgl-rw", "fgl", "lf", "chunk", "shard", "shard-local" };
+static const bool variant_sequential[] = { true, false, false, false, false, true, false, false };
+
+typedef struct Bench_Config {
+    int max_threads;                        // threads are swept 1, 2, 4, ... up to this
+    long keys;
+    long ops;
+    int scan;
+    Dist dist;
+    double theta;
+    int mix[OP_COUNT];                      // percentages, adding up to 100
+    bool variants[VAR_COUNT];
+    bool pin;
+    const char* format;                     // "table", "csv" or "json"
+    uint64_t seed;
+    int shards;                             // shard variants: key ranges, 0 for one per NUMA node
+    int numa_nodes;                         // shard variants: NUMA nodes, 0 for the machine's; more are simulated
+    bool head_only;                         // fgl, lf and shard variants: no pivot index, every descent from the head
+    bool updates;                           // inserts rewrite loaded records (uniform and zipfian only)
+} Bench_Config;
+
+// YCSB core workloads in terms of the operations every variant has; an update is an
+// insert of a key that is already there. D and E insert new records. F (read-modify-write)
+// has no equivalent.
+typedef struct Preset {
+    char name;
+    int mix[OP_COUNT];
+    Dist dist;
+    bool updates;
+} Preset;
+
+static const Preset presets[] = {
+    { 'a', { 50, 50, 0, 0 }, DIST_ZIPFIAN, true },
+    { 'b', { 95, 5, 0, 0 }, DIST_ZIPFIAN, true },
+    { 'c', { 100, 0, 0, 0 }, DIST_ZIPFIAN, false },
+    { 'd', { 95, 5, 0, 0 }, DIST_LATEST, false },
+    { 'e', { 0, 5, 0, 95 }, DIST_ZIPFIAN, false },
+};
+
+// ======================================================================== //
+// ========================= G E N E R A T O R S ========================== //
+// ======================================================================== //
+
+static uint64_t xorshift64(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static double uniform01(uint64_t* state) {
+    return (xorshift64(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static uint64_t fnv64(uint64_t x) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (int i = 0; i < 8; i++) {
+        hash = (hash ^ (x & 0xFF)) * 0x100000001B3ULL;
+        x >>= 8;
+    }
+    return hash;
+}
+
+// Zipfian ranks in [0, n) after Gray et al., "Quickly generating billion-record
+// synthetic databases", as in YCSB; zeta(n) is summed once per run
+typedef struct Zipf {
+    long n;
+    double theta, alpha, zetan, eta;
+} Zipf;
+
+static void zipf_init(Zipf* z, long n, double theta) {
+    double zeta2 = 1 + pow(0.5, theta);
+    z->n = n;
+    z->theta = theta;
+    z->alpha = 1 / (1 - theta);
+    z->zetan = 0;
+    for (long i = 1; i <= n; i++) {
+        z->zetan += 1 / pow((double)i, theta);
+    }
+    z->eta = (1 - pow(2.0 / n, 1 - theta)) / (1 - zeta2 / z->zetan);
+}
+
+static long zipf_next(const Zipf* z, uint64_t* state) {
+    double u = uniform01(state);
+    double uz = u * z->zetan;
+    if (uz < 1)
+        return 0;
+    if (uz < 1 + pow(0.5, z->theta))
+        return 1;
+    long rank = (long)(z->n * pow(z->eta * u - z->eta + 1, z->alpha));
+    return rank < z->n ? rank : z->n - 1;
+}
+
+// State shared by the threads of one run
+typedef struct Workload {
+    const Bench_Config* config;
+    Zipf zipf;
+    _Atomic long inserted;                  // sequential/latest: records below this were appended
+    _Atomic long deleted;                   // sequential: records below this were deleted
+} Workload;
+
+// An update rewrites one of the records loaded before the run, which are every other key
+static int loaded_key(const Workload* w, Op op, long key) {
+    if (op != OP_INSERT || !w->config->updates)
+        return (int)key;
+    return (int)(2 * (key % (w->config->keys / 2)));
+}
+
+static int next_key(Workload* w, Op op, uint64_t* state) {
+    long keys = w->config->keys;
+    switch (w->config->dist) {
+    case DIST_UNIFORM:
+        return loaded_key(w, op, (long)(xorshift64(state) % keys));
+    case DIST_ZIPFIAN:
+        return loaded_key(w, op, (long)(fnv64(zipf_next(&w->zipf, state)) % keys));
+    case DIST_SEQUENTIAL:
+        if (op == OP_INSERT)
+            return (int)(atomic_fetch_add(&w->inserted, 1) % keys);
+        if (op == OP_DELETE)
+            return (int)(atomic_fetch_add(&w->deleted, 1) % keys);
+        return (int)(xorshift64(state) % keys);
+    case DIST_LATEST:
+    default:
+        if (op == OP_INSERT)
+            return (int)(atomic_fetch_add(&w->inserted, 1) % keys);
+        long latest = atomic_load(&w->inserted) - 1 - zipf_next(&w->zipf, state);
+        return (int)(((latest % keys) + keys) % keys);
+    }
+}
+
+// ======================================================================== //
+// ============================= L I S T S ================================ //
+// ======================================================================== //
+
+typedef struct Bench_List {
+    Variant variant;
+    Skiplist* sl;
+    FGL_Skiplist* fgl;
+    LF_Skiplist* lf;
+    Chunk_Skiplist* chunk;
+    Shard_Skiplist* shard;
+} Bench_List;
+
+// Stop a scan once it has reported its keys
+static bool scan_count(int64_t key, void* value, void* arg) {
+    (void)key;
+    (void)value;
+    long* left = (long*)arg;
+    return --*left > 0;
+}
+
+// Fill the list with n sorted keys, bulk loading where the variant can
+static Bench_List list_prefill(Variant variant, const Bench_Config* config, const int* keys, long n) {
+    Bench_List list = { .variant = variant };
+    Skiplist_Config list_config = { .seed = config->seed, .lock = variant == VAR_CGL_RW ? LOCK_RW : LOCK_MUTEX,
+                                    .shards = config->shards, .numa_nodes = config->numa_nodes,
+                                    .head_only = config->head_only };
+    if (variant == VAR_SEQ || variant == VAR_CGL || variant == VAR_CGL_RW) {
+        int64_t* wide = malloc(n * sizeof(int64_t));
+        for (long i = 0; i < n; i++) {
+            wide[i] = keys[i];
+        }
+        list.sl = skiplist_build_sorted_with(&list_config, wide, NULL, n);
+        free(wide);
+    } else if (variant == VAR_FGL) {
+        list.fgl = fgl_skiplist_build_sorted_with(&list_config, keys, n);
+    } else if (variant == VAR_LF) {
+        list.lf = lf_skiplist_build_sorted_with(&list_config, keys, n);
+    } else if (variant == VAR_SHARD || variant == VAR_SHARD_LOCAL) {
+        list.shard = shard_skiplist_build_sorted_with(&list_config, 0, (int)config->keys, keys, n);
+    } else {
+        list.chunk = chunk_skiplist_init_with(&list_config);
+        for (long i = 0; i < n; i++) {
+            Chunk_Insert(list.chunk, keys[i]);
+        }
+    }
+    return list;
+}
+
+static void list_op(Bench_List* list, Op op, int key, int scan) {
+    long left = scan;
+    switch (list->variant) {
+    case VAR_SEQ:
+        if (op == OP_READ) Search(list->sl, key);
+        else if (op == OP_INSERT) Put(list->sl, key, NULL);
+        else if (op == OP_DELETE) Delete(list->sl, key);
+        else RangeScan(list->sl, key, INT64_MAX, scan_count, &left);
+        break;
+    case VAR_CGL:
+    case VAR_CGL_RW:
+        if (op == OP_READ) CGL_Search(list->sl, key);
+        else if (op == OP_INSERT) CGL_Put(list->sl, key, NULL);
+        else if (op == OP_DELETE) CGL_Delete(list->sl, key);
+        else CGL_RangeScan(list->sl, key, INT64_MAX, scan_count, &left);
+        break;
+    case VAR_FGL:
+        if (op == OP_READ) FGL_Search(list->fgl, key);
+        else if (op == OP_INSERT) FGL_Insert(list->fgl, key);
+        else if (op == OP_DELETE) FGL_Delete(list->fgl, key);
+        else FGL_RangeScan(list->fgl, key, MAX_INT, scan_count, &left);
+        break;
+    case VAR_LF:
+        if (op == OP_READ) LF_Search(list->lf, key);
+        else if (op == OP_INSERT) LF_Insert(list->lf, key);
+        else if (op == OP_DELETE) LF_Delete(list->lf, key);
+        else LF_RangeScan(list->lf, key, MAX_INT, scan_count, &left);
+        break;
+    case VAR_SHARD:
+    case VAR_SHARD_LOCAL:
+        if (op == OP_READ) Shard_Search(list->shard, key);
+        else if (op == OP_INSERT) Shard_Insert(list->shard, key);
+        else if (op == OP_DELETE) Shard_Delete(list->shard, key);
+        else Shard_RangeScan(list->shard, key, MAX_INT, scan_count, &left);
+        break;
+    default:
+        if (op == OP_READ) Chunk_Search(list->chunk, key);
+        else if (op == OP_INSERT) Chunk_Insert(list->chunk, key);
+        else if (op == OP_DELETE) Chunk_Delete(list->chunk, key);
+        else Chunk_RangeScan(list->chunk, key, MAX_INT, scan_count, &left);
+        break;
+    }
+}
+
+static void list_free(Bench_List* list) {
+    if (list->sl) skiplistFree(list->sl);
+    if (list->fgl) FGL_skiplistFree(list->fgl);
+    if (list->lf) LF_skiplistFree(list->lf);
+    if (list->chunk) Chunk_skiplistFree(list->chunk);
+    if (list->shard) Shard_skiplistFree(list->shard);
+}
+
+// ======================================================================== //
+// ============================== R U N S ================================= //
+// ======================================================================== //
+
+typedef struct Result {
+    Variant variant;
+    int threads;
+    long ops;
+    double seconds;
+    uint32_t p50, p99, p999;                // ns
+} Result;
+
+static inline uint32_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+static void pin_thread(int tid) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(tid % omp_get_num_procs(), &set);
+    sched_setaffinity(0, sizeof(set), &set);
+}
+
+static int latency_compare(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t percentile(const uint32_t* sorted, long n, double p) {
+    long i = (long)(p * n);
+    return sorted[i < n ? i : n - 1];
+}
+
+static Result run(const Bench_Config* config, Variant variant, int threads) {
+    Workload w = { .config = config };
+    bool appending = config->dist == DIST_SEQUENTIAL || config->dist == DIST_LATEST;
+    if (config->dist == DIST_ZIPFIAN || config->dist == DIST_LATEST)
+        zipf_init(&w.zipf, appending ? config->keys / 2 : config->keys, config->theta);
+
+    // Appending workloads start from the first half of the records, the others from every other one
+    long n = config->keys / 2;
+    int* keys = malloc(n * sizeof(int));
+    for (long i = 0; i < n; i++) {
+        keys[i] = (int)(appending ? i : 2 * i);
+    }
+    atomic_init(&w.inserted, n);
+    atomic_init(&w.deleted, 0);
+    Bench_List list = list_prefill(variant, config, keys, n);
+    free(keys);
+
+    uint32_t* latencies = malloc(config->ops * sizeof(uint32_t));
+    double start = 0, end = 0;   // latencies are in ns; a 32-bit count holds up to 4 s
+
+    #pragma omp parallel num_threads(threads)
+    {
+        int tid = omp_get_thread_num();
+        if (config->pin)
+            pin_thread(tid);
+        uint64_t state = fnv64(config->seed ^ fnv64(tid)) | 1;
+        long lo = config->ops * tid / threads, hi = config->ops * (tid + 1) / threads;
+        int local_lo = 0, local_hi = (int)config->keys;
+        if (variant == VAR_SHARD_LOCAL)
+            Shard_Local(list.shard, &local_lo, &local_hi);
+        #pragma omp barrier
+        #pragma omp master
+        start = omp_get_wtime();
+        #pragma omp barrier
+        for (long i = lo; i < hi; i++) {
+            int pick = (int)(xorshift64(&state) % 100);
+            Op op = OP_READ;
+            while (pick >= config->mix[op]) {
+                pick -= config->mix[op];
+                op++;
+            }
+            int key = next_key(&w, op, &state);
+            if (variant == VAR_SHARD_LOCAL)
+                key = local_lo + key % (local_hi - local_lo);
+            uint32_t t0 = now_ns();
+            list_op(&list, op, key, config->scan);
+            latencies[i] = now_ns() - t0;
+        }
+        #pragma omp barrier
+        #pragma omp master
+        end = omp_get_wtime();
+    }
+
+    qsort(latencies, config->ops, sizeof(uint32_t), latency_compare);
+    Result result = {
+        .variant = variant,
+        .threads = threads,
+        .ops = config->ops,
+        .seconds = end - start,
+        .p50 = percentile(latencies, config->ops, 0.50),
+        .p99 = percentile(latencies, config->ops, 0.99),
+        .p999 = percentile(latencies, config->ops, 0.999),
+    };
+    free(latencies);
+    list_free(&list);
+    return result;
+}
+
+// ======================================================================== //
+// ============================ O U T P U T =============================== //
+// ======================================================================== //
+
+static void print_header(const Bench_Config* config) {
+    if (strcmp(config->format, "csv") == 0) {
+        printf("variant,threads,keys,dist,read,insert,delete,scan,ops,seconds,ops_per_s,p50_ns,p99_ns,p999_ns\n");
+    } else if (strcmp(config->format, "json") == 0) {
+        printf("[\n");
+    } else {
+        printf("%ld keys, %ld ops, %s keys, %d%% read / %d%% insert / %d%% delete / %d%% scan of %d\n",
+               config->keys, config->ops, dist_names[config->dist], config->mix[OP_READ],
+               config->mix[OP_INSERT], config->mix[OP_DELETE], config->mix[OP_SCAN], config->scan);
+        printf("Variant     | Threads |   Mops/s |  p50 (ns) |  p99 (ns) | p999 (ns)\n");
+    }
+}
+
+static void print_result(const Bench_Config* config, const Result* r, bool first) {
+    double rate = r->ops / r->seconds;
+    const char* name = variant_names[r->variant];
+    if (strcmp(config->format, "csv") == 0) {
+        printf("%s,%d,%ld,%s,%d,%d,%d,%d,%ld,%.6f,%.0f,%u,%u,%u\n", name, r->threads, config->keys,
+               dist_names[config->dist], config->mix[OP_READ], config->mix[OP_INSERT], config->mix[OP_DELETE],
+               config->mix[OP_SCAN], r->ops, r->seconds, rate, r->p50, r->p99, r->p999);
+    } else if (strcmp(config->format, "json") == 0) {
+        printf("%s  {\"variant\": \"%s\", \"threads\": %d, \"keys\": %ld, \"dist\": \"%s\", "
+               "\"mix\": {\"read\": %d, \"insert\": %d, \"delete\": %d, \"scan\": %d}, \"ops\": %ld, "
+               "\"seconds\": %.6f, \"ops_per_s\": %.0f, \"p50_ns\": %u, \"p99_ns\": %u, \"p999_ns\": %u}",
+               first ? "" : ",\n", name, r->threads, config->keys, dist_names[config->dist], config->mix[OP_READ],
+               config->mix[OP_INSERT], config->mix[OP_DELETE], config->mix[OP_SCAN], r->ops, r->seconds, rate,
+               r->p50, r->p99, r->p999);
+    } else {
+        printf("%-11s | %7d | %8.3f | %9u | %9u | %9u\n", name, r->threads, rate / 1e6, r->p50, r->p99, r->p999);
+    }
+    fflush(stdout);
+}
+
+static void print_footer(const Bench_Config* config) {
+    if (strcmp(config->format, "json") == 0)
+        printf("\n]\n");
+}
+
+static void usage(const char* prog) {
+    printf("Usage: %s [options]\n"
+           "  -t N         sweep 1, 2, 4, ... up to N threads (default: number of cores)\n"
+           "  -k N         key space size (default %d); half of it is loaded before each run\n"
+           "  -n N         operations per run, split across the threads (default %d)\n"
+           "  -d DIST      uniform, zipfian, sequential or latest (default uniform)\n"
+           "  -z THETA     zipfian skew (default %.2f)\n"
+           "  -m R,I,D,S   percentages of reads, inserts, deletes and scans (default 90,5,5,0)\n"
+           "  -w A..E      YCSB core workload: sets the mix and distribution unless -m or -d is given;\n"
+           "               the inserts of A and B update loaded records\n"
+           "  -s N         keys per scan (default %d)\n"
+           "  -l LIST,...  variants to run: seq, cgl, cgl-rw, fgl, lf, chunk, shard, shard-local (default all)\n"
+           "  -K N         shards of the shard variants (default one per NUMA node)\n"
+           "  -N N         NUMA nodes to spread them over; more than the machine has are simulated\n"
+           "  -f FORMAT    table, csv or json (default table)\n"
+           "  -S SEED      seed of the key streams and tower heights (default 11)\n"
+           "  -P           do not pin threads to cores\n"
+           "  -H           fgl, lf and shard lists start every descent at the head, without pivots\n"
+           "seq and chunk have no synchronization and only run with one thread.\n"
+           "shard-local maps every key into the range of the shards on the thread's NUMA node.\n",
+           prog, DEFAULT_KEYS, DEFAULT_OPS, ZIPF_THETA, DEFAULT_SCAN);
+}
+
+// ======================================================================== //
+// ============================== M A I N ================================= //
+// ======================================================================== //
+
+int main(int argc, char** argv) {
+    Bench_Config config = {
+        .max_threads = omp_get_num_procs(),
+        .keys = DEFAULT_KEYS,
+        .ops = DEFAULT_OPS,
+        .scan = DEFAULT_SCAN,
+        .dist = DIST_UNIFORM,
+        .theta = ZIPF_THETA,
+        .mix = { 90, 5, 5, 0 },
+        .pin = true,
+        .format = "table",
+        .seed = 11,
+    };
+    for (int v = 0; v < VAR_COUNT; v++) {
+        config.variants[v] = true;
+    }
+    const Preset* preset = NULL;
+    bool dist_set = false, mix_set = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:k:n:d:z:m:w:s:l:f:S:K:N:PHh")) != -1) {
+        switch (opt) {
+        case 't': config.max_threads = atoi(optarg); break;
+        case 'k': config.keys = atol(optarg); break;
+        case 'n': config.ops = atol(optarg); break;
+        case 'z': config.theta = atof(optarg); break;
+        case 's': config.scan = atoi(optarg); break;
+        case 'f': config.format = optarg; break;
+        case 'S': config.seed = strtoull(optarg, NULL, 10); break;
+        case 'P': config.pin = false; break;
+        case 'H': config.head_only = true; break;
+        case 'K': config.shards = atoi(optarg); break;
+        case 'N': config.numa_nodes = atoi(optarg); break;
+        case 'd':
+            dist_set = false;
+            for (int d = 0; d < 4; d++) {
+                if (strcmp(optarg, dist_names[d]) == 0) {
+                    config.dist = (Dist)d;
+                    dist_set = true;
+                }
+            }
+            if (!dist_set) {
+                fprintf(stderr, "unknown distribution %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'm':
+            if (sscanf(optarg, "%d,%d,%d,%d", &config.mix[0], &config.mix[1], &config.mix[2], &config.mix[3]) != 4) {
+                fprintf(stderr, "expected -m R,I,D,S\n");
+                return 1;
+            }
+            mix_set = true;
+            break;
+        case 'w':
+            for (size_t p = 0; p < sizeof(presets) / sizeof(presets[0]); p++) {
+                if ((optarg[0] | 0x20) == presets[p].name)
+                    preset = &presets[p];
+            }
+            if (!preset) {
+                fprintf(stderr, "unknown workload %s; A to E are supported\n", optarg);
+                return 1;
+            }
+            break;
+        case 'l':
+            memset(config.variants, 0, sizeof(config.variants));
+            for (char* name = strtok(optarg, ","); name; name = strtok(NULL, ",")) {
+                int v = 0;
+                while (v < VAR_COUNT && strcmp(name, variant_names[v]) != 0) {
+                    v++;
+                }
+                if (v == VAR_COUNT) {
+                    fprintf(stderr, "unknown variant %s\n", name);
+                    return 1;
+                }
+                config.variants[v] = true;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (preset && !mix_set)
+        memcpy(config.mix, preset->mix, sizeof(config.mix));
+    if (preset && !dist_set)
+        config.dist = preset->dist;
+    if (preset)
+        config.updates = preset->updates;
+    if (config.mix[0] + config.mix[1] + config.mix[2] + config.mix[3] != 100 ||
+        config.keys < 2 || config.keys > MAX_INT || config.ops < 1 || config.max_threads < 1 || config.scan < 1) {
+        fprintf(stderr, "the mix must add up to 100, the key space be 2..%d and the counts positive\n", MAX_INT);
+        return 1;
+    }
+
+    print_header(&config);
+    bool first = true;
+    for (int v = 0; v < VAR_COUNT; v++) {
+        if (!config.variants[v])
+            continue;
+        int threads = 1;
+        while (true) {
+            Result result = run(&config, (Variant)v, threads);
+            print_result(&config, &result, first);
+            first = false;
+            if (variant_sequential[v] || threads == config.max_threads)
+                break;
+            threads = threads * 2 < config.max_threads ? threads * 2 : config.max_threads;
+        }
+    }
+    print_footer(&config);
+    return 0;
+}
@@ -4,19 +4,110 @@
 #include "skiplist.h"                       // include "skiplist.h" in your c program to use
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #define NUM_THREADS 8                       // change this to test the effect of the number of threads
 #define TEST_SIZE 100000                    // change this to test the effect of the size of the skip list
+#define SEED 11                             // change this to get a different but still reproducible tower layout
+#define KEY_WIDTH 16                        // size of the byte keys in the key/value map test
+#define SHORT_RANGE 16                      // keys per short range scan
+#define LONG_RANGE 10000                    // keys per long range scan
+#define BULK_SIZE 250000                    // keys in the bulk load test
+#define SNAPSHOT_PATH "skiplist_test.snap"  // written and removed by the snapshot test
+#define WAL_DIR "skiplist_wal_XXXXXX"       // temporary directory of the write-ahead log test
+#define CHUNK_TEST_SIZE 1000000             // keys in the chunked list comparison; 100000000 needs about 6 GB
+#define RANK_PROBES 4000000                 // probes per kernel and node size in the rank microbenchmark
+#define PREFETCH_SIZE 4000000               // keys in the batched search test, about 160 MB of towers
+#define PREFETCH_PROBES 20000               // lookups per batched search run
+#define SCAN_PROBES 1000                    // lookups per full scan run in the rank/select test
+#define PROFILE_SIZE 1000000                // keys in the profile test
+
+// Timings of the test sections
+static double insert_start, insert_end,
+              search_start, search_end,
+              delete_start, delete_end,
+              par_insert_start, par_insert_end,
+              par_search_start, par_search_end,
+              par_delete_start, par_delete_end;
+
+// The previous node layout: one node per key per level, linked right and down
+typedef struct Linked_Node {
+    int val;
+    struct Linked_Node *right, *down;
+} Linked_Node;
+
+// Range scan callback: add up the keys so the scan cannot be optimized away
+bool sum_keys(int64_t key, void* value, void* arg) {
+    (void)value;
+    *(long*)arg += key;
+    return true;
+}
+
+// Range scan callback: stop once *arg keys have been reported
+bool count_down(int64_t key, void* value, void* arg) {
+    (void)key;
+    (void)value;
+    return --*(long*)arg > 0;
+}
+
+// A plain pthread inserting [lo, hi) and deleting its odd keys again
+typedef struct Fill_Range {
+    FGL_Skiplist* sl;
+    int lo, hi;
+} Fill_Range;
+
+void* fill_range(void* arg) {
+    Fill_Range* range = (Fill_Range*)arg;
+    for (int i = range->lo; i < range->hi; i++) {
+        FGL_Insert(range->sl, i);
+    }
+    for (int i = range->lo + 1; i < range->hi; i += 2) {
+        FGL_Delete(range->sl, i);
+    }
+    return NULL;
+}
 
-// declace testing local variable
-omp_lock_t coarse_grained_lock;
-double  cpu_time, 
-        insert_start, insert_end,
-        search_start, search_end,
-        delete_start, delete_end,
-        par_insert_start, par_insert_end,
-        par_search_start, par_search_end,
-        par_delete_start, par_delete_end;
+// A plain pthread that waits for all the others, then inserts [lo, hi) into a lock-free list and
+// deletes its odd keys again, 64 operations to one critical section of the list's epoch
+typedef struct Epoch_Range {
+    LF_Skiplist* sl;
+    pthread_barrier_t* start;
+    int lo, hi;
+} Epoch_Range;
+
+void* epoch_range(void* arg) {
+    Epoch_Range* range = (Epoch_Range*)arg;
+    pthread_barrier_wait(range->start);
+    for (int i = range->lo; i < range->hi; i++) {
+        if ((i - range->lo) % 64 == 0)
+            epoch_enter(range->sl->epoch);
+        LF_Insert(range->sl, i);
+        if (i % 2 == 1)
+            LF_Delete(range->sl, i);
+        if ((i - range->lo) % 64 == 63 || i + 1 == range->hi)
+            epoch_exit(range->sl->epoch);
+    }
+    return NULL;
+}
+
+// Print every level of the list from the highest one in use down
+void print_levels(Skiplist* sl) {
+    int top = sl->head->level - 1;
+    while (top > 0 && !sl->head->next[top]) {
+        top--;
+    }
+    for (int level = top; level >= 0; level--) {
+        printf("      Level %d: ", level + 1);
+        Node* current = sl->head->next[level];
+        while (current) {
+            printf("%lld -> ", (long long)current->key);
+            current = current->next[level];
+        }
+        printf("NULL\n");
+    }
+}
 
 void swap(int *a, int *b) {
     int temp = *a;
@@ -35,47 +126,21 @@ void shuffle(int arr[], int n) {
 int main() {
     Skiplist* sl_10 = skiplist_init();
     omp_set_num_threads(NUM_THREADS);
-    omp_init_lock(&coarse_grained_lock);
     #pragma omp parallel for
     for (int i = 1; i <= 10; i++) {
         CGL_Insert(sl_10, i);
     }
-    omp_destroy_lock(&coarse_grained_lock);
     printf("\n============================================================\n");
     printf("  Real Time Skip List Demonstration (Coarse-grained Lock) \n");
     printf("============================================================\n");
     printf(" 1. Insert the sequence [1, 10] into a Skip List with max level of %d: \n", MAX_LEVEL);
-    Node* temp = sl_10->head;
-    for (int level = MAX_LEVEL - 1; level >= 0; level--) {
-        printf("      Level %d: ", level + 1);
-        Node* current = temp;
-        while (current) {
-            if (current->val != -MAX_INT) {
-                printf("%d -> ", current->val);
-            }
-            current = current->right;
-        }
-        printf("NULL\n");
-        temp = temp->down;
-    }
+    print_levels(sl_10);
 
     printf(" 2. Delete 3, 6, and 7 from the Skip List:\n");
     Delete(sl_10, 3);
     Delete(sl_10, 6);
     Delete(sl_10, 7);
-    Node* temp2 = sl_10->head;
-    for (int level = MAX_LEVEL - 1; level >= 0; level--) {
-        printf("      Level %d: ", level + 1);
-        Node* current = temp2;
-        while (current) {
-            if (current->val != -MAX_INT) {
-                printf("%d -> ", current->val);
-            }
-            current = current->right;
-        }
-        printf("NULL\n");
-        temp2 = temp2->down;
-    }
+    print_levels(sl_10);
 
     printf(" 3. Search for 5 and 6 in the Skip List:\n");
     printf("      Searching for 5 ... Result is: %s\n", Search(sl_10, 5) ? "Found" : "Not found");
@@ -84,19 +149,7 @@ int main() {
     printf(" 3. Insert 1 and 6; then search for 5 and 6 again:\n");
     CGL_Insert(sl_10, 1);
     CGL_Insert(sl_10, 6);
-    Node* temp3 = sl_10->head;
-    for (int level = MAX_LEVEL - 1; level >= 0; level--) {
-        printf("      Level %d: ", level + 1);
-        Node* current = temp3;
-        while (current) {
-            if (current->val != -MAX_INT) {
-                printf("%d -> ", current->val);
-            }
-            current = current->right;
-        }
-        printf("NULL\n");
-        temp3 = temp3->down;
-    }
+    print_levels(sl_10);
     printf("      Searching for 5 ... Result is: %s\n", Search(sl_10, 5) ? "Found" : "Not found");
     printf("      Searching for 6 ... Result is: %s\n\n", Search(sl_10, 6) ? "Found" : "Not found");
 
@@ -163,13 +216,11 @@ int main() {
     Skiplist* sl_ord_gl = skiplist_init();
 
     par_insert_start = omp_get_wtime();
-    omp_init_lock(&coarse_grained_lock);
     #pragma omp parallel for
-    for (int i = 1; i <= 1000; i++)
+    for (int i = 1; i <= TEST_SIZE; i++)
     {
         CGL_Insert(sl_ord_gl, i);
     }
-    omp_destroy_lock(&coarse_grained_lock);
     par_insert_end = omp_get_wtime();
     printf("-- Insertion time: %.4f ms; speedup = %.4f\n", (par_insert_end - par_insert_start) * 1000, (insert_end - insert_start)/(par_insert_end - par_insert_start));
 
@@ -179,21 +230,19 @@ int main() {
     #pragma omp parallel for
     for (int i = 1; i <= TEST_SIZE; i++)
     {
-        Search(sl_ord_gl, i);
+        CGL_Search(sl_ord_gl, i);
     }
     par_search_end = omp_get_wtime();
-    printf("-- Search time (no lock needed): %.4f ms; speedup = %.4f\n", (par_search_end - par_search_start) * 1000, (search_end - search_start)/(par_search_end - par_search_start));
+    printf("-- Search time (read lock): %.4f ms; speedup = %.4f\n", (par_search_end - par_search_start) * 1000, (search_end - search_start)/(par_search_end - par_search_start));
 
     // ===== Coarse-grained lock deletion of the ordered array [1, 100000] ====== //
 
     par_delete_start = omp_get_wtime();
-    omp_init_lock(&coarse_grained_lock);
     #pragma omp parallel for
     for (int i = 1; i <= TEST_SIZE; i++)
     {
         CGL_Delete(sl_ord_gl, i);
     }
-    omp_destroy_lock(&coarse_grained_lock);
     par_delete_end = omp_get_wtime();
     printf("-- Deletion time: %.4f ms; speedup = %.4f\n", (par_delete_end - par_delete_start) * 1000, (delete_end - delete_start)/(par_delete_end - par_delete_start));
     skiplistFree(sl_ord_gl);
@@ -210,7 +259,7 @@ int main() {
 
     par_insert_start = omp_get_wtime();
     #pragma omp parallel for
-    for (int i = 1; i <= 1000; i++)
+    for (int i = 1; i <= TEST_SIZE; i++)
     {
         FGL_Insert(sl_ord_fgl, i);
     }
@@ -264,9 +313,10 @@ int main() {
     printf("Sequential:\n");
 
     // Initiate the skip list for the ordered array [1, 100000]
-    Skiplist* sl_rand = skiplist_init();
+    Skiplist_Config seeded = { .seed = SEED };
+    Skiplist* sl_rand = skiplist_init_with(&seeded);
     insert_start = omp_get_wtime();
-    for (int i = 1; i <= TEST_SIZE; i++)
+    for (int i = 0; i < TEST_SIZE; i++)
     {
         Insert(sl_rand, random_array[i]);
     }
@@ -276,17 +326,30 @@ int main() {
     // ===== Sequential searching of the ordered array [1, 100000] ==== //
 
     search_start = omp_get_wtime();
-    for (int i = 1; i <= TEST_SIZE; i++)
+    for (int i = 0; i < TEST_SIZE; i++)
     {
         Search(sl_rand, random_array[i]);
     }
     search_end = omp_get_wtime();
-    printf("-- Search time: %.4f ms\n", (search_end - search_start) * 1000);
+    printf("-- Search time: %.4f ms (%.1f ns/op)\n", (search_end - search_start) * 1000, (search_end - search_start) * 1e9 / TEST_SIZE);
+
+    // ===== Memory layout of the random list: tower nodes vs. the old 2d linked nodes ===== //
+
+    long towers = 0, levels = 0;
+    for (Node* current = sl_rand->head->next[0]; current; current = current->next[0]) {
+        towers++;
+        levels += current->level;
+    }
+    double tower_bytes = (double)(towers + 1) * sizeof(Node) + (double)(levels + sl_rand->head->level) * sizeof(Node*);
+    double linked_nodes = levels + sl_rand->head->level;   // one node per key per level, plus a head per level
+    printf("-- Tower layout: %.3f nodes/key, %.2f bytes/key\n", (double)(towers + 1) / towers, tower_bytes / towers);
+    printf("-- 2d linked layout: %.3f nodes/key, %.2f bytes/key\n", linked_nodes / towers, linked_nodes * sizeof(Linked_Node) / towers);
+    printf("-- Tower heights with seed %d: %ld levels over %ld keys\n", SEED, levels, towers);
 
     // ===== Sequential deletion of the ordered array [1, 100000] ===== //
 
     delete_start = omp_get_wtime();
-    for (int i = 1; i <= TEST_SIZE; i++)
+    for (int i = 0; i < TEST_SIZE; i++)
     {
         Delete(sl_rand, random_array[i]);
     }
@@ -306,13 +369,11 @@ int main() {
     Skiplist* sl_rand_gl = skiplist_init();
 
     par_insert_start = omp_get_wtime();
-    omp_init_lock(&coarse_grained_lock);
     #pragma omp parallel for
-    for (int i = 1; i <= 1000; i++)
+    for (int i = 0; i < TEST_SIZE; i++)
     {
         CGL_Insert(sl_rand_gl, random_array[i]);
     }
-    omp_destroy_lock(&coarse_grained_lock);
     par_insert_end = omp_get_wtime();
 
     printf("-- Insertion time: %.4f ms; speedup = %.4f\n", (par_insert_end - par_insert_start) * 1000, (insert_end - insert_start)/(par_insert_end - par_insert_start));
@@ -321,23 +382,21 @@ int main() {
 
     par_search_start = omp_get_wtime();
     #pragma omp parallel for
-    for (int i = 1; i <= TEST_SIZE; i++)
+    for (int i = 0; i < TEST_SIZE; i++)
     {
-        Search(sl_rand_gl, random_array[i]);
+        CGL_Search(sl_rand_gl, random_array[i]);
     }
     par_search_end = omp_get_wtime();
-    printf("-- Search time (no lock needed): %.4f ms; speedup = %.4f\n", (par_search_end - par_search_start) * 1000, (search_end - search_start)/(par_search_end - par_search_start));
+    printf("-- Search time (read lock): %.4f ms; speedup = %.4f\n", (par_search_end - par_search_start) * 1000, (search_end - search_start)/(par_search_end - par_search_start));
 
     // ===== Coarse-grained lock deletion of the ordered array [1, 100000] ====== //
 
     par_delete_start = omp_get_wtime();
-    omp_init_lock(&coarse_grained_lock);
     #pragma omp parallel for
-    for (int i = 1; i <= TEST_SIZE; i++)
+    for (int i = 0; i < TEST_SIZE; i++)
     {
         CGL_Delete(sl_rand_gl, random_array[i]);
     }
-    omp_destroy_lock(&coarse_grained_lock);
     par_delete_end = omp_get_wtime();
     printf("-- Deletion time: %.4f ms; speedup = %.4f\n", (par_delete_end - par_delete_start) * 1000, (delete_end - delete_start)/(par_delete_end - par_delete_start));
     skiplistFree(sl_rand_gl);
@@ -354,7 +413,7 @@ int main() {
 
     par_insert_start = omp_get_wtime();
     #pragma omp parallel for
-    for (int i = 1; i <= 1000; i++)
+    for (int i = 0; i < TEST_SIZE; i++)
     {
         FGL_Insert(sl_rand_fgl, random_array[i]);
     }
@@ -366,7 +425,7 @@ int main() {
 
     par_search_start = omp_get_wtime();
     #pragma omp parallel for
-    for (int i = 1; i <= TEST_SIZE; i++)
+    for (int i = 0; i < TEST_SIZE; i++)
     {
         FGL_Search(sl_rand_fgl, random_array[i]);
     }
@@ -377,7 +436,7 @@ int main() {
 
     par_delete_start = omp_get_wtime();
     #pragma omp parallel for
-    for (int i = 1; i <= TEST_SIZE; i++)
+    for (int i = 0; i < TEST_SIZE; i++)
     {
         FGL_Delete(sl_rand_fgl, random_array[i]);
     }
@@ -385,5 +444,1596 @@ int main() {
     printf("-- Deletion time: %.4f ms; speedup = %.4f\n\n", (par_delete_end - par_delete_start) * 1000, (delete_end - delete_start)/(par_delete_end - par_delete_start));
     FGL_skiplistFree(sl_rand_fgl);
 
+// ======================================================================== //
+// =================== 3. T H R E A D   S C A L I N G ===================== //
+// ======================================================================== //
+
+    // ==== Insert, search and delete the random array [1, 100000] with 1, 2, 4, ... threads ==== //
+
+    printf("============================================================\n");
+    printf("    Thread scaling on a random array of length %d\n", TEST_SIZE);
+    printf("============================================================\n");
+    printf("Threads | Version | Insert (ms) | Search (ms) | Delete (ms)\n");
+
+    for (int threads = 1; threads <= NUM_THREADS; threads *= 2) {
+        omp_set_num_threads(threads);
+
+        // ===== Coarse-grained lock ===== //
+        Skiplist* sl_scale_gl = skiplist_init();
+        par_insert_start = omp_get_wtime();
+        #pragma omp parallel for
+        for (int i = 0; i < TEST_SIZE; i++)
+        {
+            CGL_Insert(sl_scale_gl, random_array[i]);
+        }
+        par_insert_end = omp_get_wtime();
+        par_search_start = omp_get_wtime();
+        #pragma omp parallel for
+        for (int i = 0; i < TEST_SIZE; i++)
+        {
+            CGL_Search(sl_scale_gl, random_array[i]);
+        }
+        par_search_end = omp_get_wtime();
+        par_delete_start = omp_get_wtime();
+        #pragma omp parallel for
+        for (int i = 0; i < TEST_SIZE; i++)
+        {
+            CGL_Delete(sl_scale_gl, random_array[i]);
+        }
+        par_delete_end = omp_get_wtime();
+        skiplistFree(sl_scale_gl);
+        printf("%7d | CGL     | %11.4f | %11.4f | %11.4f\n", threads,
+               (par_insert_end - par_insert_start) * 1000, (par_search_end - par_search_start) * 1000, (par_delete_end - par_delete_start) * 1000);
+
+        // ===== Fine-grained lock ===== //
+        FGL_Skiplist* sl_scale_fgl = fgl_skiplist_init();
+        par_insert_start = omp_get_wtime();
+        #pragma omp parallel for
+        for (int i = 0; i < TEST_SIZE; i++)
+        {
+            FGL_Insert(sl_scale_fgl, random_array[i]);
+        }
+        par_insert_end = omp_get_wtime();
+        par_search_start = omp_get_wtime();
+        #pragma omp parallel for
+        for (int i = 0; i < TEST_SIZE; i++)
+        {
+            FGL_Search(sl_scale_fgl, random_array[i]);
+        }
+        par_search_end = omp_get_wtime();
+        par_delete_start = omp_get_wtime();
+        #pragma omp parallel for
+        for (int i = 0; i < TEST_SIZE; i++)
+        {
+            FGL_Delete(sl_scale_fgl, random_array[i]);
+        }
+        par_delete_end = omp_get_wtime();
+        FGL_skiplistFree(sl_scale_fgl);
+        printf("%7d | FGL     | %11.4f | %11.4f | %11.4f\n", threads,
+               (par_insert_end - par_insert_start) * 1000, (par_search_end - par_search_start) * 1000, (par_delete_end - par_delete_start) * 1000);
+
+        // ===== Lock-free ===== //
+        LF_Skiplist* sl_scale_lf = lf_skiplist_init();
+        par_insert_start = omp_get_wtime();
+        #pragma omp parallel for
+        for (int i = 0; i < TEST_SIZE; i++)
+        {
+            LF_Insert(sl_scale_lf, random_array[i]);
+        }
+        par_insert_end = omp_get_wtime();
+        par_search_start = omp_get_wtime();
+        #pragma omp parallel for
+        for (int i = 0; i < TEST_SIZE; i++)
+        {
+            LF_Search(sl_scale_lf, random_array[i]);
+        }
+        par_search_end = omp_get_wtime();
+        par_delete_start = omp_get_wtime();
+        #pragma omp parallel for
+        for (int i = 0; i < TEST_SIZE; i++)
+        {
+            LF_Delete(sl_scale_lf, random_array[i]);
+        }
+        par_delete_end = omp_get_wtime();
+        LF_skiplistFree(sl_scale_lf);
+        printf("%7d | LF      | %11.4f | %11.4f | %11.4f\n", threads,
+               (par_insert_end - par_insert_start) * 1000, (par_search_end - par_search_start) * 1000, (par_delete_end - par_delete_start) * 1000);
+    }
+    printf("\n");
+
+// ======================================================================== //
+// ================== 4. N O D E   A L L O C A T O R ====================== //
+// ======================================================================== //
+
+    // ==== Insert the random array [1, 100000] with malloc'd vs. slab allocated nodes ==== //
+
+    printf("============================================================\n");
+    printf("    Node allocators on a random array of length %d\n", TEST_SIZE);
+    printf("============================================================\n");
+    printf("Version | Allocator | Insert (Mops/s) | Delete (Mops/s) | mallocs/op\n");
+    omp_set_num_threads(NUM_THREADS);
+
+    for (int a = 0; a < 2; a++) {
+        Skiplist_Config config = { .alloc = a == 0 ? ALLOC_MALLOC : ALLOC_SLAB };
+        const char* alloc_name = a == 0 ? "malloc" : "slab";
+
+        // ===== Coarse-grained lock ===== //
+        Skiplist* sl_alloc_gl = skiplist_init_with(&config);
+        par_insert_start = omp_get_wtime();
+        #pragma omp parallel for
+        for (int i = 0; i < TEST_SIZE; i++)
+        {
+            CGL_Insert(sl_alloc_gl, random_array[i]);
+        }
+        par_insert_end = omp_get_wtime();
+        par_delete_start = omp_get_wtime();
+        #pragma omp parallel for
+        for (int i = 0; i < TEST_SIZE; i++)
+        {
+            CGL_Delete(sl_alloc_gl, random_array[i]);
+        }
+        par_delete_end = omp_get_wtime();
+        printf("CGL     | %-9s | %15.3f | %15.3f | %10.4f\n", alloc_name,
+               TEST_SIZE / (par_insert_end - par_insert_start) / 1e6, TEST_SIZE / (par_delete_end - par_delete_start) / 1e6,
+               (double)allocator_sys_allocs(sl_alloc_gl->alloc) / TEST_SIZE);
+        skiplistFree(sl_alloc_gl);
+
+        // ===== Fine-grained lock ===== //
+        FGL_Skiplist* sl_alloc_fgl = fgl_skiplist_init_with(&config);
+        par_insert_start = omp_get_wtime();
+        #pragma omp parallel for
+        for (int i = 0; i < TEST_SIZE; i++)
+        {
+            FGL_Insert(sl_alloc_fgl, random_array[i]);
+        }
+        par_insert_end = omp_get_wtime();
+        par_delete_start = omp_get_wtime();
+        #pragma omp parallel for
+        for (int i = 0; i < TEST_SIZE; i++)
+        {
+            FGL_Delete(sl_alloc_fgl, random_array[i]);
+        }
+        par_delete_end = omp_get_wtime();
+        printf("FGL     | %-9s | %15.3f | %15.3f | %10.4f\n", alloc_name,
+               TEST_SIZE / (par_insert_end - par_insert_start) / 1e6, TEST_SIZE / (par_delete_end - par_delete_start) / 1e6,
+               (double)allocator_sys_allocs(sl_alloc_fgl->alloc) / TEST_SIZE);
+        FGL_skiplistFree(sl_alloc_fgl);
+
+        // ===== Lock-free ===== //
+        LF_Skiplist* sl_alloc_lf = lf_skiplist_init_with(&config);
+        par_insert_start = omp_get_wtime();
+        #pragma omp parallel for
+        for (int i = 0; i < TEST_SIZE; i++)
+        {
+            LF_Insert(sl_alloc_lf, random_array[i]);
+        }
+        par_insert_end = omp_get_wtime();
+        par_delete_start = omp_get_wtime();
+        #pragma omp parallel for
+        for (int i = 0; i < TEST_SIZE; i++)
+        {
+            LF_Delete(sl_alloc_lf, random_array[i]);
+        }
+        par_delete_end = omp_get_wtime();
+        printf("LF      | %-9s | %15.3f | %15.3f | %10.4f\n", alloc_name,
+               TEST_SIZE / (par_insert_end - par_insert_start) / 1e6, TEST_SIZE / (par_delete_end - par_delete_start) / 1e6,
+               (double)allocator_sys_allocs(sl_alloc_lf->alloc) / TEST_SIZE);
+        LF_skiplistFree(sl_alloc_lf);
+    }
+
+    // ==== Plain pthreads next to an OpenMP team: each thread must get a slab cache of its own ==== //
+    Skiplist_Config slab_config = { .alloc = ALLOC_SLAB };
+    FGL_Skiplist* sl_pthreads = fgl_skiplist_init_with(&slab_config);
+    pthread_t workers[4];
+    Fill_Range ranges[4];
+    for (int w = 0; w < 4; w++) {
+        ranges[w] = (Fill_Range){ sl_pthreads, (w + 1) * TEST_SIZE, (w + 2) * TEST_SIZE };
+        pthread_create(&workers[w], NULL, fill_range, &ranges[w]);
+    }
+    #pragma omp parallel for
+    for (int i = 0; i < TEST_SIZE; i++) {
+        FGL_Insert(sl_pthreads, i);
+    }
+    for (int w = 0; w < 4; w++) {
+        pthread_join(workers[w], NULL);
+    }
+    bool slots_ok = FGL_Size(sl_pthreads) == 3 * TEST_SIZE;
+    for (int i = 0; i < 5 * TEST_SIZE; i++) {
+        slots_ok &= FGL_Search(sl_pthreads, i) == (i < TEST_SIZE || i % 2 == 0);
+    }
+    FGL_skiplistFree(sl_pthreads);
+    printf("-- Threads outside the OpenMP team: %s\n", slots_ok ? "passed" : "FAILED");
+
+    // ==== More threads at once than there are slots: the ones left over share the last slot's
+    //      epoch state, each nesting its own critical sections ==== //
+    LF_Skiplist* sl_overflow = lf_skiplist_init();
+    pthread_t crowd[72];
+    Epoch_Range crowd_ranges[72];
+    pthread_barrier_t crowd_start;
+    pthread_barrier_init(&crowd_start, NULL, 72);
+    for (int w = 0; w < 72; w++) {
+        crowd_ranges[w] = (Epoch_Range){ sl_overflow, &crowd_start, w * 2000, (w + 1) * 2000 };
+        pthread_create(&crowd[w], NULL, epoch_range, &crowd_ranges[w]);
+    }
+    for (int w = 0; w < 72; w++) {
+        pthread_join(crowd[w], NULL);
+    }
+    pthread_barrier_destroy(&crowd_start);
+    bool overflow_ok = LF_Size(sl_overflow) == 72 * 1000;
+    for (int i = 0; i < 72 * 2000; i++) {
+        overflow_ok &= LF_Search(sl_overflow, i) == (i % 2 == 0);
+    }
+    LF_skiplistFree(sl_overflow);
+    printf("-- Threads past the slots sharing one epoch slot: %s\n\n", overflow_ok ? "passed" : "FAILED");
+
+// ======================================================================== //
+// ============ 5. S E A R C H   /   D E L E T E   S T R E S S ============ //
+// ======================================================================== //
+
+    // ==== Searches race with deletes of the same keys; deleted nodes must outlive the searches standing on them ==== //
+
+    printf("============================================================\n");
+    printf("    Parallel search and delete of the same %d keys\n", TEST_SIZE);
+    printf("============================================================\n");
+
+    for (int a = 0; a < 2; a++) {
+        Skiplist_Config config = { .alloc = a == 0 ? ALLOC_MALLOC : ALLOC_SLAB };
+        const char* alloc_name = a == 0 ? "malloc" : "slab";
+        int deleted, left;
+
+        // ===== Coarse-grained lock ===== //
+        Skiplist* sl_stress_gl = skiplist_init_with(&config);
+        for (int i = 0; i < TEST_SIZE; i++) {
+            Insert(sl_stress_gl, random_array[i]);
+        }
+        deleted = 0;
+        left = 0;
+        // Neighbouring iterations touch the same key and run on different threads
+        #pragma omp parallel for schedule(static, 1) reduction(+:deleted)
+        for (int i = 0; i < 4 * TEST_SIZE; i++)
+        {
+            if (i % 4 == 0)
+                deleted += CGL_Delete(sl_stress_gl, random_array[i / 4]);
+            else
+                CGL_Search(sl_stress_gl, random_array[i / 4]);
+        }
+        for (int i = 0; i < TEST_SIZE; i++) {
+            left += Search(sl_stress_gl, random_array[i]);
+        }
+        skiplistFree(sl_stress_gl);
+        printf("-- CGL (%s): %d deleted, %d left: %s\n", alloc_name, deleted, left, deleted == TEST_SIZE && left == 0 ? "passed" : "FAILED");
+
+        // ===== Fine-grained lock ===== //
+        FGL_Skiplist* sl_stress_fgl = fgl_skiplist_init_with(&config);
+        for (int i = 0; i < TEST_SIZE; i++) {
+            FGL_Insert(sl_stress_fgl, random_array[i]);
+        }
+        deleted = 0;
+        left = 0;
+        #pragma omp parallel for schedule(static, 1) reduction(+:deleted)
+        for (int i = 0; i < 4 * TEST_SIZE; i++)
+        {
+            if (i % 4 == 0)
+                deleted += FGL_Delete(sl_stress_fgl, random_array[i / 4]);
+            else
+                FGL_Search(sl_stress_fgl, random_array[i / 4]);
+        }
+        for (int i = 0; i < TEST_SIZE; i++) {
+            left += FGL_Search(sl_stress_fgl, random_array[i]);
+        }
+        FGL_skiplistFree(sl_stress_fgl);
+        printf("-- FGL (%s): %d deleted, %d left: %s\n", alloc_name, deleted, left, deleted == TEST_SIZE && left == 0 ? "passed" : "FAILED");
+
+        // ===== Lock-free ===== //
+        LF_Skiplist* sl_stress_lf = lf_skiplist_init_with(&config);
+        for (int i = 0; i < TEST_SIZE; i++) {
+            LF_Insert(sl_stress_lf, random_array[i]);
+        }
+        deleted = 0;
+        left = 0;
+        #pragma omp parallel for schedule(static, 1) reduction(+:deleted)
+        for (int i = 0; i < 4 * TEST_SIZE; i++)
+        {
+            if (i % 4 == 0)
+                deleted += LF_Delete(sl_stress_lf, random_array[i / 4]);
+            else
+                LF_Search(sl_stress_lf, random_array[i / 4]);
+        }
+        for (int i = 0; i < TEST_SIZE; i++) {
+            left += LF_Search(sl_stress_lf, random_array[i]);
+        }
+        LF_skiplistFree(sl_stress_lf);
+        printf("-- LF (%s): %d deleted, %d left: %s\n", alloc_name, deleted, left, deleted == TEST_SIZE && left == 0 ? "passed" : "FAILED");
+    }
+    printf("\n");
+
+// ======================================================================== //
+// ==================== 6. K E Y / V A L U E   M A P ====================== //
+// ======================================================================== //
+
+    // ==== Put/Get the random array as integer keys and as 16-byte keys, each mapped to its index ==== //
+
+    printf("============================================================\n");
+    printf("    Key/value map of %d keys\n", TEST_SIZE);
+    printf("============================================================\n");
+
+    int mismatches = 0;
+    Skiplist* sl_map = skiplist_init();
+    insert_start = omp_get_wtime();
+    for (int i = 0; i < TEST_SIZE; i++) {
+        Put(sl_map, random_array[i], (void*)(intptr_t)i);
+    }
+    insert_end = omp_get_wtime();
+    search_start = omp_get_wtime();
+    for (int i = 0; i < TEST_SIZE; i++) {
+        void* value;
+        if (!Get(sl_map, random_array[i], &value) || (intptr_t)value != i)
+            mismatches++;
+    }
+    search_end = omp_get_wtime();
+    printf("-- Integer keys: Put %.1f ns/op, Get %.1f ns/op\n",
+           (insert_end - insert_start) * 1e9 / TEST_SIZE, (search_end - search_start) * 1e9 / TEST_SIZE);
+    skiplistFree(sl_map);
+
+    // The list stores pointers to the byte keys, so they must outlive it
+    char (*byte_keys)[KEY_WIDTH] = malloc(sizeof(*byte_keys) * TEST_SIZE);
+    for (int i = 0; i < TEST_SIZE; i++) {
+        snprintf(byte_keys[i], KEY_WIDTH, "key-%011d", random_array[i]);
+    }
+    Skiplist_Config bytes = { .key_width = KEY_WIDTH };
+    Skiplist* sl_bytes = skiplist_init_with(&bytes);
+    insert_start = omp_get_wtime();
+    for (int i = 0; i < TEST_SIZE; i++) {
+        Put(sl_bytes, (intptr_t)byte_keys[i], (void*)(intptr_t)i);
+    }
+    insert_end = omp_get_wtime();
+    search_start = omp_get_wtime();
+    for (int i = 0; i < TEST_SIZE; i++) {
+        char probe[KEY_WIDTH];
+        void* value;
+        memcpy(probe, byte_keys[i], KEY_WIDTH);
+        if (!Get(sl_bytes, (intptr_t)probe, &value) || (intptr_t)value != i)
+            mismatches++;
+    }
+    search_end = omp_get_wtime();
+    printf("-- %d-byte keys: Put %.1f ns/op, Get %.1f ns/op\n", KEY_WIDTH,
+           (insert_end - insert_start) * 1e9 / TEST_SIZE, (search_end - search_start) * 1e9 / TEST_SIZE);
+    skiplistFree(sl_bytes);
+    free(byte_keys);
+    printf("-- Values read back: %s\n\n", mismatches == 0 ? "passed" : "FAILED");
+
+// ======================================================================== //
+// ======================== 7. R A N G E   S C A N ======================== //
+// ======================================================================== //
+
+    // ==== Scan short and long ranges of [1, 100000] in parallel ==== //
+
+    printf("============================================================\n");
+    printf("    Range scans over %d keys with %d threads\n", TEST_SIZE, NUM_THREADS);
+    printf("============================================================\n");
+    printf("Version           | %2d-key scans (Mkeys/s) | %d-key scans (Mkeys/s)\n", SHORT_RANGE, LONG_RANGE);
+
+    Skiplist* sl_scan = skiplist_init();
+    FGL_Skiplist* sl_scan_fgl = fgl_skiplist_init();
+    LF_Skiplist* sl_scan_lf = lf_skiplist_init();
+    for (int i = 0; i < TEST_SIZE; i++) {
+        Insert(sl_scan, random_array[i]);
+        FGL_Insert(sl_scan_fgl, random_array[i]);
+        LF_Insert(sl_scan_lf, random_array[i]);
+    }
+    int short_scans = TEST_SIZE / SHORT_RANGE, long_scans = TEST_SIZE / LONG_RANGE * 10;
+    long scanned, checksum = 0;
+    double short_time, long_time;
+
+    // ===== Baseline: one Search per integer of the short range ===== //
+    scanned = 0;
+    par_search_start = omp_get_wtime();
+    #pragma omp parallel for reduction(+:scanned)
+    for (int i = 0; i < short_scans; i++)
+    {
+        for (int key = i * SHORT_RANGE + 1; key <= (i + 1) * SHORT_RANGE; key++) {
+            scanned += Search(sl_scan, key);
+        }
+    }
+    par_search_end = omp_get_wtime();
+    printf("Search per key    | %22.3f | %22s\n", scanned / (par_search_end - par_search_start) / 1e6, "-");
+
+    for (int v = 0; v < 3; v++) {
+        const char* version = v == 0 ? "CGL_RangeScan" : v == 1 ? "FGL_RangeScan" : "LF_RangeScan";
+        for (int r = 0; r < 2; r++) {
+            int range = r == 0 ? SHORT_RANGE : LONG_RANGE;
+            int scans = r == 0 ? short_scans : long_scans;
+            scanned = 0;
+            par_search_start = omp_get_wtime();
+            #pragma omp parallel for reduction(+:scanned, checksum)
+            for (int i = 0; i < scans; i++)
+            {
+                int lo = (int)((long)i * range % (TEST_SIZE - range)) + 1;
+                if (v == 0)
+                    scanned += CGL_RangeScan(sl_scan, lo, lo + range, sum_keys, &checksum);
+                else if (v == 1)
+                    scanned += FGL_RangeScan(sl_scan_fgl, lo, lo + range, sum_keys, &checksum);
+                else
+                    scanned += LF_RangeScan(sl_scan_lf, lo, lo + range, sum_keys, &checksum);
+            }
+            par_search_end = omp_get_wtime();
+            if (scanned != (long)scans * range)
+                printf("-- %s reported %ld keys instead of %ld\n", version, scanned, (long)scans * range);
+            if (r == 0)
+                short_time = par_search_end - par_search_start;
+            else
+                long_time = par_search_end - par_search_start;
+        }
+        printf("%-17s | %22.3f | %22.3f\n", version,
+               (double)short_scans * SHORT_RANGE / short_time / 1e6, (double)long_scans * LONG_RANGE / long_time / 1e6);
+    }
+    skiplistFree(sl_scan);
+    FGL_skiplistFree(sl_scan_fgl);
+    LF_skiplistFree(sl_scan_lf);
+    printf("\n");
+
+// ======================================================================== //
+// ================ 8. R E A D E R - W R I T E R   L O C K ================ //
+// ======================================================================== //
+
+    // ==== Mixed CGL reads and writes on the random list, with a mutex and with the reader-writer lock ==== //
+
+    printf("============================================================\n");
+    printf("    Coarse-grained lock modes with %d threads (Mops/s)\n", NUM_THREADS);
+    printf("============================================================\n");
+    printf("Lock     | 50%% reads | 90%% reads | 99%% reads\n");
+
+    for (int l = 0; l < 2; l++) {
+        Skiplist_Config lock_config = { .lock = l == 0 ? LOCK_MUTEX : LOCK_RW };
+        printf("%-8s", l == 0 ? "mutex" : "rw");
+        int read_pcts[] = {50, 90, 99};
+        for (int r = 0; r < 3; r++) {
+            Skiplist* sl_rw = skiplist_init_with(&lock_config);
+            // Even keys start in the list, odd keys are written in and out
+            for (int i = 0; i < TEST_SIZE; i++) {
+                if (random_array[i] % 2 == 0)
+                    Insert(sl_rw, random_array[i]);
+            }
+            par_search_start = omp_get_wtime();
+            #pragma omp parallel for
+            for (int i = 0; i < TEST_SIZE; i++)
+            {
+                int key = random_array[i];
+                if ((i * 7919) % 100 < read_pcts[r])
+                    CGL_Search(sl_rw, key);
+                else if (key % 2)
+                    CGL_Insert(sl_rw, key);
+                else
+                    CGL_Delete(sl_rw, key);
+            }
+            par_search_end = omp_get_wtime();
+            printf(" | %9.3f", TEST_SIZE / (par_search_end - par_search_start) / 1e6);
+            skiplistFree(sl_rw);
+        }
+        printf("\n");
+    }
+    printf("\n");
+
+// ======================================================================== //
+// ======================== 9. B A T C H E S ============================== //
+// ======================================================================== //
+
+    // ==== Insert and delete the random array [1, 100000] in sorted batches of 1, 64 and 4096 keys ==== //
+
+    printf("============================================================\n");
+    printf("    Batched inserts and deletes of %d keys (Mkeys/s)\n", TEST_SIZE);
+    printf("============================================================\n");
+    printf("Batch | InsertBatch | DeleteBatch | CGL_InsertBatch | FGL_InsertBatch | FGL_DeleteBatch | LF_InsertBatch | LF_DeleteBatch\n");
+
+    int64_t* batch_keys = malloc(sizeof(int64_t) * TEST_SIZE);
+    for (int i = 0; i < TEST_SIZE; i++) {
+        batch_keys[i] = random_array[i];
+    }
+    int batch_sizes[] = {1, 64, 4096};
+    for (int b = 0; b < 3; b++) {
+        int batch = batch_sizes[b];
+        long removed = 0;
+
+        // ===== Sequential ===== //
+        Skiplist* sl_batch = skiplist_init();
+        insert_start = omp_get_wtime();
+        for (int i = 0; i < TEST_SIZE; i += batch) {
+            InsertBatch(sl_batch, batch_keys + i, i + batch < TEST_SIZE ? batch : TEST_SIZE - i);
+        }
+        insert_end = omp_get_wtime();
+        delete_start = omp_get_wtime();
+        for (int i = 0; i < TEST_SIZE; i += batch) {
+            removed += DeleteBatch(sl_batch, batch_keys + i, i + batch < TEST_SIZE ? batch : TEST_SIZE - i);
+        }
+        delete_end = omp_get_wtime();
+        skiplistFree(sl_batch);
+
+        // ===== Coarse-grained lock ===== //
+        Skiplist* sl_batch_gl = skiplist_init();
+        par_insert_start = omp_get_wtime();
+        #pragma omp parallel for
+        for (int i = 0; i < TEST_SIZE; i += batch)
+        {
+            CGL_InsertBatch(sl_batch_gl, batch_keys + i, i + batch < TEST_SIZE ? batch : TEST_SIZE - i);
+        }
+        par_insert_end = omp_get_wtime();
+        removed += CGL_DeleteBatch(sl_batch_gl, batch_keys, TEST_SIZE);
+        skiplistFree(sl_batch_gl);
+
+        // ===== Fine-grained lock ===== //
+        FGL_Skiplist* sl_batch_fgl = fgl_skiplist_init();
+        par_search_start = omp_get_wtime();
+        #pragma omp parallel for
+        for (int i = 0; i < TEST_SIZE; i += batch)
+        {
+            FGL_InsertBatch(sl_batch_fgl, random_array + i, i + batch < TEST_SIZE ? batch : TEST_SIZE - i);
+        }
+        par_search_end = omp_get_wtime();
+        bool batch_full = FGL_Size(sl_batch_fgl) == TEST_SIZE;
+        par_delete_start = omp_get_wtime();
+        #pragma omp parallel for reduction(+:removed)
+        for (int i = 0; i < TEST_SIZE; i += batch)
+        {
+            removed += FGL_DeleteBatch(sl_batch_fgl, random_array + i, i + batch < TEST_SIZE ? batch : TEST_SIZE - i);
+        }
+        par_delete_end = omp_get_wtime();
+        FGL_skiplistFree(sl_batch_fgl);
+
+        // ===== Lock-free ===== //
+        LF_Skiplist* sl_batch_lf = lf_skiplist_init();
+        long added = 0;
+        double lf_insert_start = omp_get_wtime();
+        #pragma omp parallel for reduction(+:added)
+        for (int i = 0; i < TEST_SIZE; i += batch)
+        {
+            added += LF_InsertBatch(sl_batch_lf, random_array + i, i + batch < TEST_SIZE ? batch : TEST_SIZE - i);
+        }
+        double lf_insert_end = omp_get_wtime();
+        batch_full = batch_full && added == TEST_SIZE && LF_Size(sl_batch_lf) == TEST_SIZE;
+        double lf_delete_start = omp_get_wtime();
+        #pragma omp parallel for reduction(+:removed)
+        for (int i = 0; i < TEST_SIZE; i += batch)
+        {
+            removed += LF_DeleteBatch(sl_batch_lf, random_array + i, i + batch < TEST_SIZE ? batch : TEST_SIZE - i);
+        }
+        double lf_delete_end = omp_get_wtime();
+        int lf_left;
+        batch_full = batch_full && !LF_PeekMin(sl_batch_lf, &lf_left);
+        LF_skiplistFree(sl_batch_lf);
+
+        printf("%5d | %11.3f | %11.3f | %15.3f | %15.3f | %15.3f | %14.3f | %14.3f%s\n", batch,
+               TEST_SIZE / (insert_end - insert_start) / 1e6, TEST_SIZE / (delete_end - delete_start) / 1e6,
+               TEST_SIZE / (par_insert_end - par_insert_start) / 1e6, TEST_SIZE / (par_search_end - par_search_start) / 1e6,
+               TEST_SIZE / (par_delete_end - par_delete_start) / 1e6,
+               TEST_SIZE / (lf_insert_end - lf_insert_start) / 1e6, TEST_SIZE / (lf_delete_end - lf_delete_start) / 1e6,
+               removed == 4L * TEST_SIZE && batch_full ? "" : "  FAILED");
+    }
+    free(batch_keys);
+    printf("\n");
+
+    // ==== Every thread inserts and then deletes all the keys, so the batches race on the same gaps ==== //
+
+    FGL_Skiplist* sl_race_fgl = fgl_skiplist_init();
+    LF_Skiplist* sl_race_lf = lf_skiplist_init();
+    long race_added = 0, race_removed = 0, race_fgl_removed = 0;
+    #pragma omp parallel num_threads(NUM_THREADS) reduction(+:race_added, race_removed, race_fgl_removed)
+    {
+        int offset = omp_get_thread_num() * 37 % 64;
+        for (int i = -offset; i < TEST_SIZE; i += 64) {
+            int from = i < 0 ? 0 : i;
+            int to = i + 64 < TEST_SIZE ? i + 64 : TEST_SIZE;
+            FGL_InsertBatch(sl_race_fgl, random_array + from, to - from);
+            race_added += LF_InsertBatch(sl_race_lf, random_array + from, to - from);
+        }
+        #pragma omp barrier
+        for (int i = -offset; i < TEST_SIZE; i += 64) {
+            int from = i < 0 ? 0 : i;
+            int to = i + 64 < TEST_SIZE ? i + 64 : TEST_SIZE;
+            race_fgl_removed += FGL_DeleteBatch(sl_race_fgl, random_array + from, to - from);
+            race_removed += LF_DeleteBatch(sl_race_lf, random_array + from, to - from);
+        }
+    }
+    printf("-- Racing batches: %ld inserted, %ld and %ld deleted%s\n", race_added, race_fgl_removed, race_removed,
+           race_added == TEST_SIZE && race_removed == TEST_SIZE && race_fgl_removed == TEST_SIZE &&
+           FGL_Size(sl_race_fgl) == 0 && LF_Size(sl_race_lf) == 0 ? "" : "  FAILED");
+    FGL_skiplistFree(sl_race_fgl);
+    LF_skiplistFree(sl_race_lf);
+
+    // ==== Every thread's batch for a block starts with the block's first key, which all of them insert,
+    //      and goes on with 63 keys only it inserts: a batch that loses the gap to another thread finds
+    //      the first key there when it retries and must still link its own keys ==== //
+
+    int anchor_span = 1 + 63 * NUM_THREADS;
+    int anchor_keys = TEST_SIZE / 25 * anchor_span;
+    FGL_Skiplist* sl_anchor_fgl = fgl_skiplist_init();
+    LF_Skiplist* sl_anchor_lf = lf_skiplist_init();
+    #pragma omp parallel num_threads(NUM_THREADS)
+    {
+        int tid = omp_get_thread_num();
+        int anchored[64];
+        for (int first = 0; first < anchor_keys; first += anchor_span) {
+            anchored[0] = first;
+            for (int i = 1; i < 64; i++) {
+                anchored[i] = first + tid * 63 + i;
+            }
+            FGL_InsertBatch(sl_anchor_fgl, anchored, 64);
+            LF_InsertBatch(sl_anchor_lf, anchored, 64);
+        }
+    }
+    long anchor_found = 0;
+    for (int key = 0; key < anchor_keys; key++) {
+        anchor_found += FGL_Search(sl_anchor_fgl, key) + LF_Search(sl_anchor_lf, key);
+    }
+    printf("-- Batches retrying behind another thread: %ld of %d keys found%s\n", anchor_found, 2 * anchor_keys,
+           anchor_found == 2 * anchor_keys && FGL_Size(sl_anchor_fgl) == anchor_keys &&
+           LF_Size(sl_anchor_lf) == anchor_keys ? "" : "  FAILED");
+    FGL_skiplistFree(sl_anchor_fgl);
+    LF_skiplistFree(sl_anchor_lf);
+    printf("\n");
+
+    // ==== FGL_Insert key by key against FGL_InsertBatch in batches of 64, on ordered and random keys ==== //
+
+    printf("Keys    | FGL_Insert | FGL_InsertBatch  (Mkeys/s)\n");
+    int* ordered_keys = malloc(sizeof(int) * TEST_SIZE);
+    for (int i = 0; i < TEST_SIZE; i++) {
+        ordered_keys[i] = i + 1;
+    }
+    for (int r = 0; r < 2; r++) {
+        int* keys = r == 0 ? ordered_keys : random_array;
+        FGL_Skiplist* sl_single = fgl_skiplist_init();
+        par_insert_start = omp_get_wtime();
+        #pragma omp parallel for schedule(static, 64)
+        for (int i = 0; i < TEST_SIZE; i++) {
+            FGL_Insert(sl_single, keys[i]);
+        }
+        par_insert_end = omp_get_wtime();
+        FGL_Skiplist* sl_runs = fgl_skiplist_init();
+        par_search_start = omp_get_wtime();
+        #pragma omp parallel for
+        for (int i = 0; i < TEST_SIZE; i += 64)
+        {
+            FGL_InsertBatch(sl_runs, keys + i, i + 64 < TEST_SIZE ? 64 : TEST_SIZE - i);
+        }
+        par_search_end = omp_get_wtime();
+        printf("%-7s | %10.3f | %15.3f%s\n", r == 0 ? "ordered" : "random",
+               TEST_SIZE / (par_insert_end - par_insert_start) / 1e6, TEST_SIZE / (par_search_end - par_search_start) / 1e6,
+               FGL_Size(sl_single) == TEST_SIZE && FGL_Size(sl_runs) == TEST_SIZE ? "" : "  FAILED");
+        FGL_skiplistFree(sl_single);
+        FGL_skiplistFree(sl_runs);
+    }
+    free(ordered_keys);
+    printf("\n");
+
+// ======================================================================== //
+// ======================== 10. B U L K   L O A D ========================= //
+// ======================================================================== //
+
+    // ==== Load the ordered array [1, BULK_SIZE] with Insert and with the bottom-up build ==== //
+
+    printf("============================================================\n");
+    printf("    Loading %d sorted keys with %d threads (ms)\n", BULK_SIZE, NUM_THREADS);
+    printf("============================================================\n");
+
+    int64_t* bulk_keys = malloc(sizeof(int64_t) * BULK_SIZE);
+    int* bulk_nums = malloc(sizeof(int) * BULK_SIZE);
+    for (int i = 0; i < BULK_SIZE; i++) {
+        bulk_keys[i] = i + 1;
+        bulk_nums[i] = i + 1;
+    }
+    Skiplist_Config bulk_config = { .alloc = ALLOC_SLAB };
+
+    insert_start = omp_get_wtime();
+    Skiplist* sl_bulk = skiplist_init_with(&bulk_config);
+    for (int i = 1; i <= BULK_SIZE; i++) {
+        Insert(sl_bulk, i);
+    }
+    insert_end = omp_get_wtime();
+    printf("-- Insert one by one:       %9.1f\n", (insert_end - insert_start) * 1e3);
+    skiplistFree(sl_bulk);
+
+    int bulk_missing = 0;
+    insert_start = omp_get_wtime();
+    sl_bulk = skiplist_build_sorted_with(&bulk_config, bulk_keys, NULL, BULK_SIZE);
+    insert_end = omp_get_wtime();
+    printf("-- skiplist_build_sorted:   %9.1f\n", (insert_end - insert_start) * 1e3);
+    #pragma omp parallel for reduction(+:bulk_missing)
+    for (int i = 0; i < TEST_SIZE; i++)
+    {
+        bulk_missing += !Search(sl_bulk, random_array[i]);
+    }
+    skiplistFree(sl_bulk);
+
+    insert_start = omp_get_wtime();
+    FGL_Skiplist* sl_bulk_fgl = fgl_skiplist_build_sorted_with(&bulk_config, bulk_nums, BULK_SIZE);
+    insert_end = omp_get_wtime();
+    printf("-- fgl_skiplist_build_sorted: %7.1f\n", (insert_end - insert_start) * 1e3);
+    #pragma omp parallel for reduction(+:bulk_missing)
+    for (int i = 0; i < TEST_SIZE; i++)
+    {
+        bulk_missing += !FGL_Search(sl_bulk_fgl, random_array[i]);
+    }
+    bulk_missing += !FGL_Delete(sl_bulk_fgl, BULK_SIZE / 2) || FGL_Search(sl_bulk_fgl, BULK_SIZE / 2);
+    FGL_skiplistFree(sl_bulk_fgl);
+
+    insert_start = omp_get_wtime();
+    LF_Skiplist* sl_bulk_lf = lf_skiplist_build_sorted_with(&bulk_config, bulk_nums, BULK_SIZE);
+    insert_end = omp_get_wtime();
+    printf("-- lf_skiplist_build_sorted: %8.1f\n", (insert_end - insert_start) * 1e3);
+    #pragma omp parallel for reduction(+:bulk_missing)
+    for (int i = 0; i < TEST_SIZE; i++)
+    {
+        bulk_missing += !LF_Search(sl_bulk_lf, random_array[i]);
+    }
+    bulk_missing += !LF_Delete(sl_bulk_lf, BULK_SIZE / 2) || LF_Search(sl_bulk_lf, BULK_SIZE / 2);
+    LF_skiplistFree(sl_bulk_lf);
+    free(bulk_keys);
+    free(bulk_nums);
+    printf("-- Built lists searchable: %s\n\n", bulk_missing == 0 ? "passed" : "FAILED");
+
+// ======================================================================== //
+// ================== 11. M E R G E   A N D   S E T S ===================== //
+// ======================================================================== //
+
+    // ==== Merge a delta list {3i} into a main list {2i}, i < BULK_SIZE, and build the set operations ==== //
+
+    printf("============================================================\n");
+    printf("    Merging %d + %d keys with %d threads (ms)\n", BULK_SIZE, BULK_SIZE, NUM_THREADS);
+    printf("============================================================\n");
+
+    int64_t* main_keys = malloc(sizeof(int64_t) * BULK_SIZE);
+    int64_t* delta_keys = malloc(sizeof(int64_t) * BULK_SIZE);
+    long union_size = 0, inter_size = 0, diff_size = 0, set_sum = 0;
+    for (int i = 0; i < BULK_SIZE; i++) {
+        main_keys[i] = 2L * i;
+        delta_keys[i] = 3L * i;
+    }
+    for (long k = 0; k < 3L * BULK_SIZE; k++) {
+        bool in_main = k % 2 == 0 && k < 2L * BULK_SIZE, in_delta = k % 3 == 0;
+        union_size += in_main || in_delta;
+        inter_size += in_main && in_delta;
+        diff_size += in_main && !in_delta;
+    }
+    Skiplist* sl_main = skiplist_build_sorted(main_keys, BULK_SIZE);
+    Skiplist* sl_delta = skiplist_build_sorted(delta_keys, BULK_SIZE);
+    bool sets_ok = true;
+
+    // ===== Baseline: Put every key of the delta into the main list ===== //
+    insert_start = omp_get_wtime();
+    for (int i = 0; i < BULK_SIZE; i++) {
+        Put(sl_main, delta_keys[i], NULL);
+    }
+    insert_end = omp_get_wtime();
+    printf("-- Put per key:             %9.1f\n", (insert_end - insert_start) * 1e3);
+    sets_ok &= RangeScan(sl_main, INT64_MIN, INT64_MAX, sum_keys, &set_sum) == union_size;
+    skiplistFree(sl_main);
+
+    sl_main = skiplist_build_sorted(main_keys, BULK_SIZE);
+    insert_start = omp_get_wtime();
+    skiplist_merge(sl_main, sl_delta);
+    insert_end = omp_get_wtime();
+    printf("-- skiplist_merge:          %9.1f\n", (insert_end - insert_start) * 1e3);
+    sets_ok &= RangeScan(sl_main, INT64_MIN, INT64_MAX, sum_keys, &set_sum) == union_size;
+    skiplistFree(sl_main);
+
+    sl_main = skiplist_build_sorted(main_keys, BULK_SIZE);
+    for (int op = 0; op < 3; op++) {
+        insert_start = omp_get_wtime();
+        Skiplist* sl_set = op == 0 ? skiplist_union(sl_main, sl_delta)
+                         : op == 1 ? skiplist_intersection(sl_main, sl_delta)
+                                   : skiplist_difference(sl_main, sl_delta);
+        insert_end = omp_get_wtime();
+        printf("-- %-24s %9.1f\n", op == 0 ? "skiplist_union:" : op == 1 ? "skiplist_intersection:" : "skiplist_difference:",
+               (insert_end - insert_start) * 1e3);
+        sets_ok &= RangeScan(sl_set, INT64_MIN, INT64_MAX, sum_keys, &set_sum) == (op == 0 ? union_size : op == 1 ? inter_size : diff_size);
+        skiplistFree(sl_set);
+    }
+    skiplistFree(sl_main);
+    skiplistFree(sl_delta);
+    free(main_keys);
+    free(delta_keys);
+    printf("-- Result sizes: %s\n\n", sets_ok ? "passed" : "FAILED");
+
+// ======================================================================== //
+// ======================== 12. S N A P S H O T S ========================= //
+// ======================================================================== //
+
+    // ==== Save [1, BULK_SIZE] to a snapshot file, then compare reopening it with rebuilding ==== //
+
+    printf("============================================================\n");
+    printf("    Restarting with %d keys (ms)\n", BULK_SIZE);
+    printf("============================================================\n");
+
+    bool snapshot_ok = true;
+    Skiplist* sl_saved = skiplist_init();
+    for (int i = 1; i <= BULK_SIZE; i++) {
+        Put(sl_saved, i, (void*)(intptr_t)(i * 2));
+    }
+    insert_start = omp_get_wtime();
+    snapshot_ok &= skiplist_save(sl_saved, SNAPSHOT_PATH);
+    insert_end = omp_get_wtime();
+    printf("-- skiplist_save:           %9.1f\n", (insert_end - insert_start) * 1e3);
+    skiplistFree(sl_saved);
+
+    insert_start = omp_get_wtime();
+    Skiplist* sl_rebuilt = skiplist_init();
+    for (int i = 1; i <= BULK_SIZE; i++) {
+        Put(sl_rebuilt, i, (void*)(intptr_t)(i * 2));
+    }
+    insert_end = omp_get_wtime();
+    printf("-- Rebuild with Put:        %9.1f\n", (insert_end - insert_start) * 1e3);
+    skiplistFree(sl_rebuilt);
+
+    // Open and answer the first lookup: the keys are only paged in when searched
+    void* snapshot_value;
+    insert_start = omp_get_wtime();
+    Skiplist* sl_snap = skiplist_open_mmap(SNAPSHOT_PATH);
+    snapshot_ok &= sl_snap && Get(sl_snap, BULK_SIZE / 2, &snapshot_value) && (intptr_t)snapshot_value == BULK_SIZE;
+    insert_end = omp_get_wtime();
+    printf("-- skiplist_open_mmap:      %9.3f\n", (insert_end - insert_start) * 1e3);
+    if (!sl_snap) {
+        printf("-- Snapshot: FAILED\n\n");
+        return 1;
+    }
+
+    search_start = omp_get_wtime();
+    snapshot_ok &= skiplist_verify(sl_snap);
+    search_end = omp_get_wtime();
+    printf("-- skiplist_verify:         %9.1f\n", (search_end - search_start) * 1e3);
+
+    // Reads go to the mapped file, writes to the overlay above it
+    int snapshot_missing = 0;
+    par_search_start = omp_get_wtime();
+    #pragma omp parallel for reduction(+:snapshot_missing)
+    for (int i = 0; i < TEST_SIZE; i++)
+    {
+        snapshot_missing += !Search(sl_snap, random_array[i]);
+    }
+    par_search_end = omp_get_wtime();
+    printf("-- Search the snapshot:     %9.1f ns/op\n", (par_search_end - par_search_start) * 1e9 / TEST_SIZE);
+    for (int i = 0; i < TEST_SIZE; i++) {
+        if (random_array[i] % 2)
+            snapshot_ok &= Delete(sl_snap, random_array[i]);
+    }
+    Insert(sl_snap, BULK_SIZE + 1);
+    long snapshot_keys = RangeScan(sl_snap, INT64_MIN, INT64_MAX, sum_keys, &set_sum);
+    snapshot_ok &= snapshot_missing == 0 && snapshot_keys == BULK_SIZE - TEST_SIZE / 2 + 1 && !Search(sl_snap, 1);
+    skiplistFree(sl_snap);
+    remove(SNAPSHOT_PATH);
+    printf("-- Snapshot with overlay: %s\n\n", snapshot_ok ? "passed" : "FAILED");
+
+// ======================================================================== //
+// =================== 13. W R I T E - A H E A D   L O G ================== //
+// ======================================================================== //
+
+    // ==== CGL_Put [1, 100000] into a logged list, wait until durable, then replay the log ==== //
+
+    printf("============================================================\n");
+    printf("    Logged CGL_Put of %d keys, %d threads\n", TEST_SIZE, NUM_THREADS);
+    printf("============================================================\n");
+
+    char wal_dir[] = WAL_DIR;
+    char wal_path[sizeof(wal_dir) + 16];
+    bool wal_ok = mkdtemp(wal_dir) != NULL;
+    snprintf(wal_path, sizeof(wal_path), "%s/log", wal_dir);
+    size_t groups[] = {1, 16, 256, 4096};
+    for (int g = 0; wal_ok && g < 4; g++) {
+        Skiplist_Config wal_config = { .wal_group = groups[g] };
+        Skiplist* sl_wal = skiplist_open_wal(&wal_config, wal_path);
+        wal_ok = sl_wal != NULL;
+        if (!wal_ok)
+            break;
+        par_insert_start = omp_get_wtime();
+        #pragma omp parallel for
+        for (int i = 0; i < TEST_SIZE; i++)
+        {
+            CGL_Put(sl_wal, random_array[i], (void*)(intptr_t)(random_array[i] * 2));
+        }
+        wal_ok &= skiplist_wal_sync(sl_wal);
+        par_insert_end = omp_get_wtime();
+        // Half the keys go again, so the replay has deletes to fold
+        for (int i = 0; i < TEST_SIZE; i += 2) {
+            CGL_Delete(sl_wal, random_array[i]);
+        }
+        skiplistFree(sl_wal);
+
+        insert_start = omp_get_wtime();
+        Skiplist* sl_replayed = skiplist_open_wal(&wal_config, wal_path);
+        insert_end = omp_get_wtime();
+        void* wal_value = NULL;
+        wal_ok &= sl_replayed && RangeScan(sl_replayed, INT64_MIN, INT64_MAX, sum_keys, &set_sum) == TEST_SIZE / 2 &&
+                  !Search(sl_replayed, random_array[0]) && Get(sl_replayed, random_array[1], &wal_value) &&
+                  (intptr_t)wal_value == random_array[1] * 2;
+        printf("-- Group of %4zu records: %8.1f Kops/s durable, replay %6.1f ms\n", groups[g],
+               TEST_SIZE / (par_insert_end - par_insert_start) / 1e3, (insert_end - insert_start) * 1e3);
+        if (sl_replayed)
+            skiplistFree(sl_replayed);
+        remove(wal_path);
+    }
+    rmdir(wal_dir);
+    printf("-- Replay: %s\n\n", wal_ok ? "passed" : "FAILED");
+
+// ======================================================================== //
+// ================== 14. C H U N K E D   B O T T O M ===================== //
+// ======================================================================== //
+
+    // ==== Insert a shuffled [1, CHUNK_TEST_SIZE] into towers and into chunks, then search and scan ==== //
+
+    printf("============================================================\n");
+    printf("    Towers vs. chunks of %d keys, %d keys\n", CHUNK_KEYS, CHUNK_TEST_SIZE);
+    printf("============================================================\n");
+
+    int* chunk_keys = malloc(CHUNK_TEST_SIZE * sizeof(int));
+    for (int i = 0; i < CHUNK_TEST_SIZE; i++) {
+        chunk_keys[i] = i + 1;
+    }
+    shuffle(chunk_keys, CHUNK_TEST_SIZE);
+    Skiplist_Config chunk_config = { .alloc = ALLOC_SLAB, .seed = SEED };
+    Skiplist* sl_towers = skiplist_init_with(&chunk_config);
+    Chunk_Skiplist* sl_chunks = chunk_skiplist_init_with(&chunk_config);
+    for (int i = 0; i < CHUNK_TEST_SIZE; i++) {
+        Insert(sl_towers, chunk_keys[i]);
+        Chunk_Insert(sl_chunks, chunk_keys[i]);
+    }
+
+    double tower_layout = 0, chunk_layout = 0;
+    long chunk_count = 0;
+    for (Node* current = sl_towers->head; current; current = current->next[0]) {
+        tower_layout += sizeof(Node) + current->level * sizeof(Node*);
+    }
+    for (Chunk_Node* current = sl_chunks->head; current; current = current->next[0]) {
+        chunk_layout += sizeof(Chunk_Node) + current->level * sizeof(Chunk_Node*);
+        chunk_count++;
+    }
+
+    bool chunk_ok = true;
+    search_start = omp_get_wtime();
+    for (int i = 0; i < CHUNK_TEST_SIZE; i++) {
+        chunk_ok &= Search(sl_towers, chunk_keys[i]);
+    }
+    search_end = omp_get_wtime();
+    double tower_search = (search_end - search_start) * 1e9 / CHUNK_TEST_SIZE;
+    search_start = omp_get_wtime();
+    for (int i = 0; i < CHUNK_TEST_SIZE; i++) {
+        chunk_ok &= Chunk_Search(sl_chunks, chunk_keys[i]);
+    }
+    search_end = omp_get_wtime();
+    double chunk_search = (search_end - search_start) * 1e9 / CHUNK_TEST_SIZE;
+
+    long tower_sum = 0, chunk_sum = 0;
+    par_search_start = omp_get_wtime();
+    chunk_ok &= RangeScan(sl_towers, INT64_MIN, INT64_MAX, sum_keys, &tower_sum) == CHUNK_TEST_SIZE;
+    par_search_end = omp_get_wtime();
+    double tower_scan = (par_search_end - par_search_start) * 1e9 / CHUNK_TEST_SIZE;
+    par_search_start = omp_get_wtime();
+    chunk_ok &= Chunk_RangeScan(sl_chunks, 0, MAX_INT, sum_keys, &chunk_sum) == CHUNK_TEST_SIZE;
+    par_search_end = omp_get_wtime();
+    double chunk_scan = (par_search_end - par_search_start) * 1e9 / CHUNK_TEST_SIZE;
+    chunk_ok &= tower_sum == chunk_sum;
+
+    printf("--          Search ns/op  Scan ns/key  Bytes/key\n");
+    printf("-- Towers:  %11.1f  %11.2f  %9.2f\n", tower_search, tower_scan, tower_layout / CHUNK_TEST_SIZE);
+    printf("-- Chunks:  %11.1f  %11.2f  %9.2f  (%.1f keys/chunk)\n", chunk_search, chunk_scan,
+           chunk_layout / CHUNK_TEST_SIZE, (double)CHUNK_TEST_SIZE / chunk_count);
+
+    // Deleting every other key makes chunks underflow, merge and borrow
+    for (int i = 0; i < CHUNK_TEST_SIZE; i += 2) {
+        chunk_ok &= Chunk_Delete(sl_chunks, chunk_keys[i]);
+    }
+    chunk_ok &= !Chunk_Delete(sl_chunks, chunk_keys[0]) && Chunk_Insert(sl_chunks, chunk_keys[0]) && !Chunk_Insert(sl_chunks, chunk_keys[1]);
+    for (int i = 0; i < CHUNK_TEST_SIZE; i++) {
+        chunk_ok &= Chunk_Search(sl_chunks, chunk_keys[i]) == (i % 2 == 1 || i == 0);
+    }
+    chunk_sum = 0;
+    chunk_ok &= Chunk_RangeScan(sl_chunks, 0, MAX_INT, sum_keys, &chunk_sum) == CHUNK_TEST_SIZE / 2 + 1;
+    skiplistFree(sl_towers);
+    Chunk_skiplistFree(sl_chunks);
+    free(chunk_keys);
+    printf("-- Chunked list: %s\n\n", chunk_ok ? "passed" : "FAILED");
+
+// ======================================================================== //
+// ====================== 15. R A N K   K E R N E L S ===================== //
+// ======================================================================== //
+
+    // ==== Rank random probes in 4096 sorted nodes of 8 to 64 keys with every kernel the CPU has ==== //
+
+    const char* kernel_names[] = {"scalar", "SSE4.2", "AVX2"};
+    printf("============================================================\n");
+    printf("    Rank kernels, ns/rank (startup pick: %s)\n", kernel_names[rank_kernel()]);
+    printf("============================================================\n");
+
+    int rank_nodes = 4096;
+    int* rank_arrays = malloc(rank_nodes * 64 * sizeof(int));
+    int* rank_probes = malloc(RANK_PROBES * sizeof(int));
+    bool rank_ok = true;
+    srand(SEED);
+    for (int i = 0; i < RANK_PROBES; i++) {
+        rank_probes[i] = rand();
+    }
+    printf("-- Keys   ");
+    for (int kernel = RANK_SCALAR; kernel <= (int)rank_kernel(); kernel++) {
+        printf("%9s", kernel_names[kernel]);
+    }
+    printf("\n");
+    for (int n = 8; n <= 64; n *= 2) {
+        for (int i = 0; i < rank_nodes * n; i++) {
+            rank_arrays[i] = i % n * 1000;
+        }
+        long first_sum = 0;
+        printf("-- %4d   ", n);
+        for (int kernel = RANK_SCALAR; kernel <= (int)rank_kernel(); kernel++) {
+            long sum = 0;
+            search_start = omp_get_wtime();
+            for (int i = 0; i < RANK_PROBES; i++) {
+                sum += rank_keys(kernel, rank_arrays + i % rank_nodes * n, n, rank_probes[i] % (n * 1000));
+            }
+            search_end = omp_get_wtime();
+            first_sum = kernel == RANK_SCALAR ? sum : first_sum;
+            rank_ok &= sum == first_sum;
+            printf("%9.2f", (search_end - search_start) * 1e9 / RANK_PROBES);
+        }
+        printf("\n");
+    }
+    free(rank_arrays);
+    free(rank_probes);
+    printf("-- Kernels agree: %s\n\n", rank_ok ? "passed" : "FAILED");
+
+// ======================================================================== //
+// ================== 16. B A T C H E D   S E A R C H ===================== //
+// ======================================================================== //
+
+    // ==== Look up random keys in a list larger than the last level cache, one by one and batched ==== //
+
+    printf("============================================================\n");
+    printf("    %d lookups in %d even keys (ns/op)\n", PREFETCH_PROBES, PREFETCH_SIZE);
+    printf("============================================================\n");
+
+    int64_t* prefetch_keys = malloc(PREFETCH_SIZE * sizeof(int64_t));
+    int64_t* prefetch_probes = malloc(PREFETCH_PROBES * sizeof(int64_t));
+    bool* prefetch_loop = malloc(PREFETCH_PROBES * sizeof(bool));
+    bool* prefetch_batch = malloc(PREFETCH_PROBES * sizeof(bool));
+    for (int i = 0; i < PREFETCH_SIZE; i++) {
+        prefetch_keys[i] = 2 * (int64_t)i;
+    }
+    srand(SEED);
+    for (int i = 0; i < PREFETCH_PROBES; i++) {
+        prefetch_probes[i] = ((int64_t)rand() * RAND_MAX + rand()) % (2 * (int64_t)PREFETCH_SIZE);
+    }
+    Skiplist* sl_large = skiplist_build_sorted(prefetch_keys, PREFETCH_SIZE);
+
+    search_start = omp_get_wtime();
+    for (int i = 0; i < PREFETCH_PROBES; i++) {
+        prefetch_loop[i] = Search(sl_large, prefetch_probes[i]);
+    }
+    search_end = omp_get_wtime();
+    double loop_ns = (search_end - search_start) * 1e9 / PREFETCH_PROBES;
+    search_start = omp_get_wtime();
+    SearchBatch(sl_large, prefetch_probes, PREFETCH_PROBES, prefetch_batch);
+    search_end = omp_get_wtime();
+    double batch_ns = (search_end - search_start) * 1e9 / PREFETCH_PROBES;
+
+    bool prefetch_ok = true;
+    for (int i = 0; i < PREFETCH_PROBES; i++) {
+        prefetch_ok &= prefetch_batch[i] == prefetch_loop[i] && prefetch_loop[i] == (prefetch_probes[i] % 2 == 0);
+    }
+    printf("-- Search loop:  %10.1f\n", loop_ns);
+    printf("-- SearchBatch:  %10.1f  (%.2fx)\n", batch_ns, loop_ns / batch_ns);
+    skiplistFree(sl_large);
+    free(prefetch_keys);
+    free(prefetch_probes);
+    free(prefetch_loop);
+    free(prefetch_batch);
+    printf("-- Batched results: %s\n\n", prefetch_ok ? "passed" : "FAILED");
+
+// ======================================================================== //
+// ========================= 17. L E V E L S ============================== //
+// ======================================================================== //
+
+    // ==== Search lists of 100000 and 1000000 keys capped at 10 levels and with adaptive levels ==== //
+
+    printf("============================================================\n");
+    printf("    Search ns/op: 10 fixed levels vs. adaptive levels\n");
+    printf("============================================================\n");
+
+    bool levels_ok = true;
+    Skiplist_Config fixed_config = { .max_level = 10, .fixed_levels = true };
+    for (int size = TEST_SIZE; size <= CHUNK_TEST_SIZE; size *= 10) {
+        int64_t* level_keys = malloc(size * sizeof(int64_t));
+        for (int i = 0; i < size; i++) {
+            level_keys[i] = i + 1;
+        }
+        Skiplist* sl_fixed = skiplist_build_sorted_with(&fixed_config, level_keys, NULL, size);
+        Skiplist* sl_adaptive = skiplist_build_sorted(level_keys, size);
+        int scale = size / TEST_SIZE;
+        search_start = omp_get_wtime();
+        for (int i = 0; i < TEST_SIZE; i++) {
+            levels_ok &= Search(sl_fixed, random_array[i] * scale);
+        }
+        search_end = omp_get_wtime();
+        double fixed_ns = (search_end - search_start) * 1e9 / TEST_SIZE;
+        search_start = omp_get_wtime();
+        for (int i = 0; i < TEST_SIZE; i++) {
+            levels_ok &= Search(sl_adaptive, random_array[i] * scale);
+        }
+        search_end = omp_get_wtime();
+        double adaptive_ns = (search_end - search_start) * 1e9 / TEST_SIZE;
+        int adaptive_top = sl_adaptive->head->level;
+        while (adaptive_top > 1 && !sl_adaptive->head->next[adaptive_top - 1]) {
+            adaptive_top--;
+        }
+        printf("-- %7d keys:  fixed %9.1f   adaptive %7.1f  (%d levels)\n", size, fixed_ns, adaptive_ns, adaptive_top);
+        skiplistFree(sl_fixed);
+        skiplistFree(sl_adaptive);
+        free(level_keys);
+    }
+
+    // Inserted one at a time, an adaptive list grows its levels with its size
+    Skiplist* sl_grown = skiplist_init_with(&seeded);
+    for (int i = 0; i < TEST_SIZE; i++) {
+        Insert(sl_grown, random_array[i]);
+    }
+    int grown_top = sl_grown->head->level;
+    while (grown_top > 1 && !sl_grown->head->next[grown_top - 1]) {
+        grown_top--;
+    }
+    for (int i = 0; i < TEST_SIZE; i++) {
+        levels_ok &= Search(sl_grown, random_array[i]);
+    }
+    printf("-- %d inserts grew the list to %d levels\n", TEST_SIZE, grown_top);
+    levels_ok &= grown_top > 10 && grown_top < 24;
+    skiplistFree(sl_grown);
+    printf("-- Levels: %s\n\n", levels_ok ? "passed" : "FAILED");
+
+// ======================================================================== //
+// ================= 18. S I Z E ,  R A N K ,  S E L E C T ================ //
+// ======================================================================== //
+
+    // ==== Rank and Select on an indexed list after inserts and deletes, against full scans ==== //
+
+    printf("============================================================\n");
+    printf("    Rank / Select on %d keys (ns/op)\n", TEST_SIZE);
+    printf("============================================================\n");
+
+    // Insert 1..TEST_SIZE in random order, then delete every multiple of 3
+    bool index_ok = true;
+    Skiplist_Config indexed = { .seed = SEED, .indexed = true };
+    Skiplist* sl_indexed = skiplist_init_with(&indexed);
+    for (int i = 0; i < TEST_SIZE; i++) {
+        Insert(sl_indexed, random_array[i]);
+    }
+    for (int i = 0; i < TEST_SIZE; i++) {
+        if (random_array[i] % 3 == 0)
+            Delete(sl_indexed, random_array[i]);
+    }
+    long left = TEST_SIZE - TEST_SIZE / 3;
+    index_ok &= Size(sl_indexed) == left;
+    // Key k has k - 1 - (k - 1) / 3 keys below it, and rank r belongs to key r + r / 2 + 1
+    for (int k = 1; k <= TEST_SIZE; k++) {
+        index_ok &= Rank(sl_indexed, k) == k - 1 - (k - 1) / 3;
+    }
+    for (long r = 0; r < left; r++) {
+        int64_t key;
+        index_ok &= Select(sl_indexed, r, &key, NULL) && key == r + r / 2 + 1;
+    }
+    index_ok &= !Select(sl_indexed, left, NULL, NULL) && Rank(sl_indexed, INT64_MAX) == left;
+
+    long rank_sum = 0;
+    search_start = omp_get_wtime();
+    for (int i = 0; i < TEST_SIZE; i++) {
+        rank_sum += Rank(sl_indexed, random_array[i]);
+    }
+    search_end = omp_get_wtime();
+    printf("-- Rank:                 %9.1f\n", (search_end - search_start) * 1e9 / TEST_SIZE);
+    long scan_sum = 0;
+    search_start = omp_get_wtime();
+    for (int i = 0; i < SCAN_PROBES; i++) {
+        long dummy = 0;
+        scan_sum += RangeScan(sl_indexed, INT64_MIN, random_array[i], sum_keys, &dummy);
+    }
+    search_end = omp_get_wtime();
+    printf("-- Rank by range scan:   %9.1f\n", (search_end - search_start) * 1e9 / SCAN_PROBES);
+    for (int i = 0; i < SCAN_PROBES; i++) {
+        scan_sum -= Rank(sl_indexed, random_array[i]);
+    }
+    index_ok &= scan_sum == 0 && rank_sum > 0;
+
+    search_start = omp_get_wtime();
+    for (int i = 0; i < TEST_SIZE; i++) {
+        int64_t key;
+        index_ok &= Select(sl_indexed, random_array[i] % left, &key, NULL);
+    }
+    search_end = omp_get_wtime();
+    printf("-- Select:               %9.1f\n", (search_end - search_start) * 1e9 / TEST_SIZE);
+    search_start = omp_get_wtime();
+    for (int i = 0; i < SCAN_PROBES; i++) {
+        Cursor cur;
+        int64_t key = 0;
+        Seek(&cur, sl_indexed, INT64_MIN);
+        for (long r = 0; r <= random_array[i] % left; r++) {
+            Next(&cur, &key, NULL);
+        }
+        Cursor_Close(&cur);
+        index_ok &= key == random_array[i] % left + random_array[i] % left / 2 + 1;
+    }
+    search_end = omp_get_wtime();
+    printf("-- Select by cursor:     %9.1f\n", (search_end - search_start) * 1e9 / SCAN_PROBES);
+
+    // Size sums the counters, a full scan walks the bottom level
+    long size_sum = 0;
+    search_start = omp_get_wtime();
+    for (int i = 0; i < SCAN_PROBES; i++) {
+        size_sum += Size(sl_indexed);
+    }
+    search_end = omp_get_wtime();
+    printf("-- Size:                 %9.1f\n", (search_end - search_start) * 1e9 / SCAN_PROBES);
+    search_start = omp_get_wtime();
+    for (int i = 0; i < SCAN_PROBES; i++) {
+        long dummy = 0;
+        size_sum -= RangeScan(sl_indexed, INT64_MIN, INT64_MAX, sum_keys, &dummy);
+    }
+    search_end = omp_get_wtime();
+    printf("-- Size by range scan:   %9.1f\n", (search_end - search_start) * 1e9 / SCAN_PROBES);
+    index_ok &= size_sum == 0;
+    skiplistFree(sl_indexed);
+
+    // Bulk loads and set operations build the spans too
+    int64_t* index_keys = malloc(sizeof(int64_t) * BULK_SIZE);
+    for (int i = 0; i < BULK_SIZE; i++) {
+        index_keys[i] = 2L * i;
+    }
+    Skiplist* sl_even = skiplist_build_sorted_with(&indexed, index_keys, NULL, BULK_SIZE);
+    for (int i = 0; i < BULK_SIZE; i++) {
+        index_keys[i] = 3L * i;
+    }
+    Skiplist* sl_triple = skiplist_build_sorted_with(&indexed, index_keys, NULL, BULK_SIZE);
+    Skiplist* sl_union = skiplist_union(sl_even, sl_triple);
+    long union_count = 0;
+    for (long k = 0; k < 3L * BULK_SIZE; k++) {
+        if ((k % 2 == 0 && k < 2L * BULK_SIZE) || k % 3 == 0) {
+            int64_t key;
+            index_ok &= Select(sl_union, union_count, &key, NULL) && key == k && Rank(sl_union, k) == union_count;
+            union_count++;
+        }
+    }
+    index_ok &= Size(sl_union) == union_count && Size(sl_even) == BULK_SIZE;
+    for (int i = 0; i < BULK_SIZE; i += 997) {
+        int64_t key;
+        index_ok &= Select(sl_even, i, &key, NULL) && key == 2L * i;
+    }
+    skiplistFree(sl_union);
+    skiplistFree(sl_even);
+    skiplistFree(sl_triple);
+    free(index_keys);
+    printf("-- Rank / Select: %s\n", index_ok ? "passed" : "FAILED");
+
+    // ===== Sizes of the concurrent lists after parallel inserts and deletes ===== //
+    bool size_ok = true;
+    Skiplist* sl_size_gl = skiplist_init();
+    FGL_Skiplist* sl_size_fgl = fgl_skiplist_init();
+    LF_Skiplist* sl_size_lf = lf_skiplist_init();
+    #pragma omp parallel for
+    for (int i = 0; i < TEST_SIZE; i++) {
+        CGL_Insert(sl_size_gl, random_array[i]);
+        FGL_Insert(sl_size_fgl, random_array[i]);
+        LF_Insert(sl_size_lf, random_array[i]);
+        FGL_Insert(sl_size_fgl, random_array[i]);     // already there: not counted twice
+        LF_Insert(sl_size_lf, random_array[i]);
+    }
+    #pragma omp parallel for
+    for (int i = 0; i < TEST_SIZE; i++) {
+        if (random_array[i] % 3 == 0) {
+            CGL_Delete(sl_size_gl, random_array[i]);
+            FGL_Delete(sl_size_fgl, random_array[i]);
+            LF_Delete(sl_size_lf, random_array[i]);
+        }
+    }
+    size_ok &= Size(sl_size_gl) == left && FGL_Size(sl_size_fgl) == left && LF_Size(sl_size_lf) == left;
+    skiplistFree(sl_size_gl);
+    FGL_skiplistFree(sl_size_fgl);
+    LF_skiplistFree(sl_size_lf);
+    printf("-- Sizes after %d parallel inserts and deletes: %s\n\n", NUM_THREADS, size_ok ? "passed" : "FAILED");
+
+// ======================================================================== //
+// ============================ 19. S T A T S ============================= //
+// ======================================================================== //
+
+    // ==== FGL insert, search and delete the random array [1, 100000] and dump the counters ==== //
+    // (only kept when skiplist.c is compiled with -DSKIPLIST_STATS)
+    skiplist_stats_reset();
+    FGL_Skiplist* sl_stats = fgl_skiplist_init();
+    #pragma omp parallel for
+    for (int i = 0; i < TEST_SIZE; i++) {
+        FGL_Insert(sl_stats, random_array[i]);
+    }
+    #pragma omp parallel for
+    for (int i = 0; i < TEST_SIZE; i++) {
+        FGL_Search(sl_stats, random_array[i]);
+    }
+    #pragma omp parallel for
+    for (int i = 0; i < TEST_SIZE; i++) {
+        FGL_Delete(sl_stats, random_array[i]);
+    }
+    FGL_skiplistFree(sl_stats);
+    skiplist_stats_dump();
+
+    Skiplist_Stats stats;
+    bool stats_ok;
+    if (skiplist_stats(&stats)) {
+        stats_ok = stats.ops[STAT_INSERT] == TEST_SIZE && stats.ops[STAT_SEARCH] == TEST_SIZE &&
+                   stats.ops[STAT_DELETE] == TEST_SIZE && stats.ops[STAT_SCAN] == 0 &&
+                   stats.allocs == TEST_SIZE + 1 && stats.lock_acquires >= 2L * TEST_SIZE && stats.visited[0] > 0;
+        for (int op = 0; op < STAT_OPS; op++) {
+            long timed = 0;
+            for (int b = 0; b < STATS_BUCKETS; b++) {
+                timed += stats.latency[op][b];
+            }
+            stats_ok &= timed == stats.ops[op];
+        }
+    } else {
+        // Compiled out: nothing may have been counted
+        stats_ok = stats.ops[STAT_INSERT] == 0 && stats.allocs == 0 && stats.lock_acquires == 0;
+    }
+    printf("-- Stats: %s\n\n", stats_ok ? "passed" : "FAILED");
+
+// ======================================================================== //
+// ========================== 20. P R O F I L E =========================== //
+// ======================================================================== //
+
+    // ==== Profile a list of PROFILE_SIZE shuffled keys in full and from a 1% sample ==== //
+    bool profile_ok = true;
+    Skiplist* sl_profile = skiplist_init_with(&seeded);
+    for (long i = 0; i < PROFILE_SIZE; i++) {
+        Insert(sl_profile, i * 7919 % PROFILE_SIZE);    // 7919 is prime, so every key once
+    }
+    Skiplist_Profile full, sampled;
+    double full_start = omp_get_wtime();
+    skiplist_profile(sl_profile, 1, &full);
+    double full_end = omp_get_wtime();
+    skiplist_profile(sl_profile, 0.01, &sampled);
+    double sampled_end = omp_get_wtime();
+    skiplist_profile_print(&sampled);
+    printf("-- Profile: full walk %.3f s, 1%% sample %.3f s\n", full_end - full_start, sampled_end - full_end);
+
+    profile_ok &= full.nodes == PROFILE_SIZE && full.level[0].nodes == PROFILE_SIZE;
+    profile_ok &= sampled.nodes == PROFILE_SIZE && sampled.level[0].nodes == PROFILE_SIZE;
+    for (int level = 1; level < 6; level++) {
+        // p = 1/2: a link skips two links of the level below on average, and the sample agrees
+        profile_ok &= full.level[level].mean_gap > 1.8 && full.level[level].mean_gap < 2.2;
+        double gap_error = sampled.level[level].mean_gap - full.level[level].mean_gap;
+        profile_ok &= gap_error > -0.2 && gap_error < 0.2;
+        profile_ok &= full.heights[level - 1] > 0.9 * full.ideal[level - 1] && full.heights[level - 1] < 1.1 * full.ideal[level - 1];
+    }
+    profile_ok &= full.heap_bytes > full.node_bytes && full.node_bytes >= full.level[0].bytes;
+    skiplistFree(sl_profile);
+
+    // A list that stays at 1000 keys while a million come and go keeps the levels of 1000 towers
+    Skiplist* sl_churn = skiplist_init_with(&seeded);
+    for (long i = 0; i < PROFILE_SIZE; i++) {
+        Insert(sl_churn, i);
+        if (i >= 1000)
+            Delete(sl_churn, i - 1000);
+    }
+    Skiplist_Profile churn;
+    skiplist_profile(sl_churn, 1, &churn);
+    profile_ok &= churn.nodes == 1000 && churn.levels <= 11;
+    skiplistFree(sl_churn);
+    printf("-- Profile: %s\n\n", profile_ok ? "passed" : "FAILED");
+
+// ======================================================================== //
+// =========================== 21. S H A R D S ============================ //
+// ======================================================================== //
+
+    // ==== Parallel insert the random array [1, 100000] into 8 shards on 4 simulated NUMA nodes ==== //
+    bool shard_ok = true;
+    Skiplist_Config shard_config = { .seed = SEED, .shards = 8, .numa_nodes = 4 };
+    Shard_Skiplist* sl_shard = shard_skiplist_init_with(&shard_config, 1, TEST_SIZE + 1);
+    FGL_Skiplist* sl_shard_fgl = fgl_skiplist_init();
+    par_insert_start = omp_get_wtime();
+    #pragma omp parallel for
+    for (int i = 0; i < TEST_SIZE; i++) {
+        FGL_Insert(sl_shard_fgl, random_array[i]);
+    }
+    par_insert_end = omp_get_wtime();
+    double fgl_time = par_insert_end - par_insert_start;
+    par_insert_start = omp_get_wtime();
+    #pragma omp parallel for
+    for (int i = 0; i < TEST_SIZE; i++) {
+        Shard_Insert(sl_shard, random_array[i]);
+    }
+    par_insert_end = omp_get_wtime();
+    printf("-- Parallel insert: FGL %.4f s, %d shards %.4f s\n", fgl_time, sl_shard->shards, par_insert_end - par_insert_start);
+
+    shard_ok &= Shard_Size(sl_shard) == TEST_SIZE;
+    #pragma omp parallel for reduction(&&: shard_ok)
+    for (int i = 0; i < TEST_SIZE; i++) {
+        shard_ok = shard_ok && Shard_Search(sl_shard, random_array[i]);
+    }
+    // Scans cross the shard bounds in order, and stop where the callback says
+    long shard_sum = 0;
+    shard_ok &= Shard_RangeScan(sl_shard, 0, TEST_SIZE + 1, sum_keys, &shard_sum) == TEST_SIZE;
+    shard_ok &= shard_sum == (long)TEST_SIZE * (TEST_SIZE + 1) / 2;
+    long scan_left = 20;
+    shard_ok &= Shard_RangeScan(sl_shard, TEST_SIZE / 8 - 10, MAX_INT, count_down, &scan_left) == 20;
+    #pragma omp parallel for
+    for (int i = 0; i < TEST_SIZE; i++) {
+        if (random_array[i] % 2 == 0)
+            Shard_Delete(sl_shard, random_array[i]);
+    }
+    shard_ok &= Shard_Size(sl_shard) == TEST_SIZE / 2 && !Shard_Search(sl_shard, 2) && Shard_Search(sl_shard, 1);
+
+    // Thread t of NUM_THREADS is on simulated node t * 4 / NUM_THREADS and gets its two shards
+    int local_nodes[NUM_THREADS], local_lo[NUM_THREADS], local_hi[NUM_THREADS];
+    #pragma omp parallel num_threads(NUM_THREADS)
+    {
+        int t = omp_get_thread_num();
+        local_nodes[t] = Shard_Local(sl_shard, &local_lo[t], &local_hi[t]);
+    }
+    for (int t = 0; t < NUM_THREADS; t++) {
+        int node = t * 4 / NUM_THREADS;
+        shard_ok &= local_nodes[t] == node && local_lo[t] == sl_shard->bounds[2 * node] && local_hi[t] == sl_shard->bounds[2 * node + 2];
+    }
+    Shard_skiplistFree(sl_shard);
+    FGL_skiplistFree(sl_shard_fgl);
+
+    // A bulk loaded sharded list holds the same keys
+    int* shard_keys = malloc(TEST_SIZE * sizeof(int));
+    for (int i = 0; i < TEST_SIZE; i++) {
+        shard_keys[i] = 3 * i;
+    }
+    Shard_Skiplist* sl_shard_built = shard_skiplist_build_sorted_with(&shard_config, 0, 3 * TEST_SIZE, shard_keys, TEST_SIZE);
+    shard_ok &= Shard_Size(sl_shard_built) == TEST_SIZE;
+    for (int i = 0; i < TEST_SIZE; i++) {
+        shard_ok &= Shard_Search(sl_shard_built, 3 * i) && !Shard_Search(sl_shard_built, 3 * i + 1);
+    }
+    Shard_skiplistFree(sl_shard_built);
+    free(shard_keys);
+    printf("-- Shards: %s\n\n", shard_ok ? "passed" : "FAILED");
+
+// ======================================================================== //
+// ================= 22. P R I O R I T Y   Q U E U E ====================== //
+// ======================================================================== //
+
+    // ==== Sequential pops come out in ascending order on every variant ==== //
+    bool pq_ok = true;
+    Skiplist* sl_pq = skiplist_init();
+    FGL_Skiplist* sl_pq_fgl = fgl_skiplist_init();
+    LF_Skiplist* sl_pq_lf = lf_skiplist_init();
+    Chunk_Skiplist* sl_pq_chunk = chunk_skiplist_init();
+    Shard_Skiplist* sl_pq_shard = shard_skiplist_init(0, TEST_SIZE + 1);
+    for (int i = 0; i < TEST_SIZE; i++) {
+        Insert(sl_pq, random_array[i]);
+        FGL_Insert(sl_pq_fgl, random_array[i]);
+        LF_Insert(sl_pq_lf, random_array[i]);
+        Chunk_Insert(sl_pq_chunk, random_array[i]);
+        Shard_Insert(sl_pq_shard, random_array[i]);
+    }
+    int64_t min_key;
+    int min[5];
+    pq_ok &= PeekMin(sl_pq, &min_key, NULL) && min_key == 1 && Size(sl_pq) == TEST_SIZE;
+    for (int i = 1; i <= TEST_SIZE; i++) {
+        pq_ok &= PopMin(sl_pq, &min_key, NULL) && min_key == i;
+        pq_ok &= FGL_PopMin(sl_pq_fgl, &min[0]) && min[0] == i;
+        pq_ok &= LF_SprayPopMin(sl_pq_lf, &min[1]) && min[1] == i;     // alone a spray is strict
+        pq_ok &= Chunk_PopMin(sl_pq_chunk, &min[2]) && min[2] == i;
+        pq_ok &= Shard_PopMin(sl_pq_shard, &min[3]) && min[3] == i;
+    }
+    pq_ok &= !PeekMin(sl_pq, NULL, NULL) && !PopMin(sl_pq, NULL, NULL) && Size(sl_pq) == 0;
+    pq_ok &= !FGL_PeekMin(sl_pq_fgl, NULL) && !LF_PeekMin(sl_pq_lf, NULL) && !LF_SprayPopMin(sl_pq_lf, NULL);
+    pq_ok &= !Chunk_PeekMin(sl_pq_chunk, NULL) && !Shard_PeekMin(sl_pq_shard, NULL);
+    skiplistFree(sl_pq);
+    FGL_skiplistFree(sl_pq_fgl);
+    LF_skiplistFree(sl_pq_lf);
+    Chunk_skiplistFree(sl_pq_chunk);
+    Shard_skiplistFree(sl_pq_shard);
+
+    // ==== Parallel pops drain the list, each key exactly once; pops/s against the thread count ==== //
+    int64_t* pq_keys = malloc(TEST_SIZE * sizeof(int64_t));
+    int* pq_nums = malloc(TEST_SIZE * sizeof(int));
+    for (int i = 0; i < TEST_SIZE; i++) {
+        pq_keys[i] = pq_nums[i] = i + 1;
+    }
+    const char* pq_names[4] = {"CGL strict", "FGL", "LF", "LF spray"};
+    printf("Pops/s        threads:");
+    for (int threads = 1; threads <= NUM_THREADS; threads *= 2) {
+        printf("%10d", threads);
+    }
+    printf("\n");
+    for (int variant = 0; variant < 4; variant++) {
+        printf("   %-19s", pq_names[variant]);
+        for (int threads = 1; threads <= NUM_THREADS; threads *= 2) {
+            Skiplist* cgl = variant == 0 ? skiplist_build_sorted(pq_keys, TEST_SIZE) : NULL;
+            FGL_Skiplist* fgl = variant == 1 ? fgl_skiplist_build_sorted(pq_nums, TEST_SIZE) : NULL;
+            LF_Skiplist* lf = variant >= 2 ? lf_skiplist_build_sorted(pq_nums, TEST_SIZE) : NULL;
+            long popped = 0, popped_sum = 0;
+            double pop_start = omp_get_wtime();
+            #pragma omp parallel num_threads(threads) reduction(+:popped, popped_sum)
+            {
+                int64_t key;
+                int num;
+                while (true) {
+                    bool found = variant == 0 ? CGL_PopMin(cgl, &key, NULL) :
+                                 variant == 1 ? FGL_PopMin(fgl, &num) :
+                                 variant == 2 ? LF_PopMin(lf, &num) : LF_SprayPopMin(lf, &num);
+                    if (!found)
+                        break;
+                    popped++;
+                    popped_sum += variant == 0 ? key : num;
+                }
+            }
+            double pop_time = omp_get_wtime() - pop_start;
+            printf("%10.0f", TEST_SIZE / pop_time);
+            pq_ok &= popped == TEST_SIZE && popped_sum == (long)TEST_SIZE * (TEST_SIZE + 1) / 2;
+            if (cgl)
+                skiplistFree(cgl);
+            if (fgl)
+                FGL_skiplistFree(fgl);
+            if (lf)
+                LF_skiplistFree(lf);
+        }
+        printf("\n");
+    }
+    free(pq_keys);
+    free(pq_nums);
+    printf("-- Priority queue: %s\n\n", pq_ok ? "passed" : "FAILED");
+
+// ======================================================================== //
+// ========================== 23. P I V O T S ============================= //
+// ======================================================================== //
+
+    // ==== Odd keys stay while tall and short towers of even keys come and go under searches ==== //
+    bool pivot_ok = true, pivot_stats = false;
+    double upper_visits[2] = { 0, 0 };
+    for (int head_only = 0; head_only <= 1; head_only++) {
+        Skiplist_Config pivot_config = { .head_only = head_only };
+        FGL_Skiplist* sl_pivot_fgl = fgl_skiplist_init_with(&pivot_config);
+        LF_Skiplist* sl_pivot_lf = lf_skiplist_init_with(&pivot_config);
+        #pragma omp parallel for
+        for (int i = 0; i < TEST_SIZE; i++) {
+            FGL_Insert(sl_pivot_fgl, 2 * random_array[i] + 1);
+            LF_Insert(sl_pivot_lf, 2 * random_array[i] + 1);
+        }
+        long missing = 0;
+        #pragma omp parallel num_threads(NUM_THREADS) reduction(+:missing)
+        {
+            int t = omp_get_thread_num();
+            for (int round = 0; round < 4; round++) {
+                for (int i = t / 2; i < TEST_SIZE; i += NUM_THREADS / 2) {
+                    int key = 2 * random_array[i];
+                    if (t % 2 == 0) {
+                        FGL_Insert(sl_pivot_fgl, key);
+                        LF_Insert(sl_pivot_lf, key);
+                        FGL_Delete(sl_pivot_fgl, key);
+                        LF_Delete(sl_pivot_lf, key);
+                    } else {
+                        missing += !FGL_Search(sl_pivot_fgl, key + 1) + !LF_Search(sl_pivot_lf, key + 1);
+                    }
+                }
+            }
+        }
+        pivot_ok &= missing == 0 && FGL_Size(sl_pivot_fgl) == TEST_SIZE && LF_Size(sl_pivot_lf) == TEST_SIZE;
+
+        // Searches from the pivots only walk the levels far above log2(TEST_SIZE / 32) to find
+        // the towers reaching the pivot level
+        skiplist_stats_reset();
+        for (int i = 1; i <= TEST_SIZE; i++) {
+            pivot_ok &= FGL_Search(sl_pivot_fgl, 2 * i + 1) && !FGL_Search(sl_pivot_fgl, 2 * i);
+            pivot_ok &= LF_Search(sl_pivot_lf, 2 * i + 1) && !LF_Search(sl_pivot_lf, 2 * i);
+        }
+        Skiplist_Stats stats;
+        if ((pivot_stats = skiplist_stats(&stats))) {
+            long upper = 0;
+            for (int level = 13; level < MAX_LEVEL; level++) {
+                upper += stats.visited[level];
+            }
+            upper_visits[head_only] = (double)upper / (4 * TEST_SIZE);
+        }
+        FGL_skiplistFree(sl_pivot_fgl);
+        LF_skiplistFree(sl_pivot_lf);
+    }
+    if (pivot_stats) {
+        printf("-- Node visits per search above level 13: pivots %.4f, head only %.4f\n", upper_visits[0], upper_visits[1]);
+        pivot_ok &= upper_visits[0] < upper_visits[1] / 100;
+    }
+    printf("-- Pivots: %s\n\n", pivot_ok ? "passed" : "FAILED");
+
     return 0;
 }
\ No newline at end of file